@@ -0,0 +1,217 @@
+// Vertex-array rendering. Everything is plain GL 1.1 (client-side arrays,
+// glDrawArrays/glDrawElements) so it links against stock opengl32 without a
+// loader.
+//
+//  VertexBatch  - per-frame quads/lines, merged into runs of equal state and
+//                 drawn in submission order on flush().
+//  QuadLayer    - persistent quads indexed by slot, patched in place.
+//  QuadPool     - persistent quads keyed by slot, O(1) insert/erase, used for
+//                 sprites that come and go.
+//
+// The persistent meshes can also draw just the slots in a list (the ones on
+// screen) through an index array, without touching the vertices.
+#pragma once
+
+#include <GL/freeglut.h>
+#include <vector>
+
+struct BatchVertex {
+    GLfloat x, y;
+    GLfloat u, v;
+    GLubyte r, g, b, a;
+};
+
+inline GLubyte toByte(float c) { return (GLubyte)(c <= 0.0f ? 0 : c >= 1.0f ? 255 : c * 255.0f + 0.5f); }
+
+struct QuadColor {
+    GLubyte r, g, b, a;
+    QuadColor(float r_ = 1, float g_ = 1, float b_ = 1, float a_ = 1)
+        : r(toByte(r_)), g(toByte(g_)), b(toByte(b_)), a(toByte(a_)) {}
+};
+
+// Texture-space box for a sprite fitted (aspect preserved, centred) into a rect.
+struct SpriteQuad {
+    int x, y, w, h;
+    float u0, v0, u1, v1;
+};
+
+inline SpriteQuad fitSprite(int texW, int texH, int rx, int ry, int rw, int rh, bool flipX, bool flipY) {
+    float tAspect = (texH == 0) ? 1.0f : (float)texW / (float)texH;
+    float bAspect = (float)rw / (float)rh;
+    int drawW = rw, drawH = rh;
+    if (tAspect > bAspect) drawH = (int)(rw / tAspect);
+    else drawW = (int)(rh * tAspect);
+    SpriteQuad q;
+    q.x = rx + (rw - drawW) / 2; q.y = ry + (rh - drawH) / 2;
+    q.w = drawW; q.h = drawH;
+    q.u0 = flipX ? 1.0f : 0.0f; q.u1 = flipX ? 0.0f : 1.0f;
+    q.v0 = flipY ? 0.0f : 1.0f; q.v1 = flipY ? 1.0f : 0.0f;
+    return q;
+}
+
+inline void writeQuad(BatchVertex *v, float x, float y, float w, float h, QuadColor c,
+                      float u0 = 0, float v0 = 0, float u1 = 0, float v1 = 0) {
+    v[0] = { x,     y,     u0, v0, c.r, c.g, c.b, c.a };
+    v[1] = { x + w, y,     u1, v0, c.r, c.g, c.b, c.a };
+    v[2] = { x + w, y + h, u1, v1, c.r, c.g, c.b, c.a };
+    v[3] = { x,     y + h, u0, v1, c.r, c.g, c.b, c.a };
+}
+
+// Rect outline as four GL_LINES segments (8 vertices) so outlines batch.
+inline void writeOutline(BatchVertex *v, float x, float y, float w, float h, QuadColor c) {
+    float xs[4] = { x, x + w, x + w, x }, ys[4] = { y, y, y + h, y + h };
+    for (int k = 0; k < 4; ++k) {
+        int n = (k + 1) & 3;
+        v[2 * k]     = { xs[k], ys[k], 0, 0, c.r, c.g, c.b, c.a };
+        v[2 * k + 1] = { xs[n], ys[n], 0, 0, c.r, c.g, c.b, c.a };
+    }
+}
+
+class RenderStats {
+public:
+    static int &drawCalls() { static int n = 0; return n; }
+};
+
+// Indices of `per` consecutive vertices starting at vertex first * per.
+inline void appendIndices(std::vector<GLuint> &out, size_t first, int per) {
+    for (int k = 0; k < per; ++k) out.push_back((GLuint)(first * per + k));
+}
+
+// With indices, count is the number of indices.
+inline void drawVertices(const BatchVertex *v, int count, GLenum prim, GLuint tex, float lineWidth = 1.0f,
+                         const GLuint *indices = nullptr) {
+    if (count <= 0) return;
+    if (tex) { glEnable(GL_TEXTURE_2D); glBindTexture(GL_TEXTURE_2D, tex); }
+    else glDisable(GL_TEXTURE_2D);
+    if (prim == GL_LINES) glLineWidth(lineWidth);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(BatchVertex), &v->x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(BatchVertex), &v->r);
+    if (tex) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(BatchVertex), &v->u);
+    }
+    if (indices) glDrawElements(prim, count, GL_UNSIGNED_INT, indices);
+    else glDrawArrays(prim, 0, count);
+    ++RenderStats::drawCalls();
+    if (tex) {
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glColor3f(1, 1, 1);
+}
+
+class VertexBatch {
+public:
+    void rect(int x, int y, int w, int h, QuadColor c) {
+        BatchVertex *v = append(GL_QUADS, 0, 1.0f, 4);
+        writeQuad(v, (float)x, (float)y, (float)w, (float)h, c);
+    }
+
+    void border(int x, int y, int w, int h, float lineWidth, QuadColor c) {
+        BatchVertex *v = append(GL_LINES, 0, lineWidth, 8);
+        writeOutline(v, (float)x, (float)y, (float)w, (float)h, c);
+    }
+
+    void sprite(GLuint tex, const SpriteQuad &q, QuadColor c = QuadColor()) {
+        if (!tex) return;
+        BatchVertex *v = append(GL_QUADS, tex, 1.0f, 4);
+        writeQuad(v, (float)q.x, (float)q.y, (float)q.w, (float)q.h, c, q.u0, q.v0, q.u1, q.v1);
+    }
+
+    void flush() {
+        for (auto &r: runs) drawVertices(&verts[r.first], r.count, r.prim, r.tex, r.lineWidth);
+        runs.clear();
+        verts.clear();
+    }
+
+private:
+    struct Run {
+        GLenum prim;
+        GLuint tex;
+        float lineWidth;
+        int first, count;
+    };
+    std::vector<BatchVertex> verts;
+    std::vector<Run> runs;
+
+    BatchVertex *append(GLenum prim, GLuint tex, float lineWidth, int count) {
+        if (runs.empty() || runs.back().prim != prim || runs.back().tex != tex || runs.back().lineWidth != lineWidth)
+            runs.push_back({ prim, tex, lineWidth, (int)verts.size(), 0 });
+        runs.back().count += count;
+        verts.resize(verts.size() + count);
+        return &verts[verts.size() - count];
+    }
+};
+
+class QuadLayer {
+public:
+    void resize(size_t quads) { verts.assign(quads * 4, BatchVertex()); }
+    size_t size() const { return verts.size() / 4; }
+    BatchVertex *quad(size_t i) { return &verts[i * 4]; }
+
+    void setColor(size_t i, QuadColor c) {
+        for (int k = 0; k < 4; ++k) { BatchVertex &v = verts[i * 4 + k]; v.r = c.r; v.g = c.g; v.b = c.b; v.a = c.a; }
+    }
+
+    void draw(GLuint tex = 0) const { if (!verts.empty()) drawVertices(&verts[0], (int)verts.size(), GL_QUADS, tex); }
+
+    // Only the listed quads; scratch holds the index array between frames.
+    void draw(const std::vector<int> &quads, std::vector<GLuint> &scratch, GLuint tex = 0) const {
+        scratch.clear();
+        for (int i: quads) appendIndices(scratch, (size_t)i, 4);
+        if (!scratch.empty()) drawVertices(&verts[0], (int)scratch.size(), GL_QUADS, tex, 1.0f, &scratch[0]);
+    }
+
+private:
+    std::vector<BatchVertex> verts;
+};
+
+class QuadPool {
+public:
+    void reset(size_t keys) { where.assign(keys, -1); owner.clear(); verts.clear(); }
+    size_t capacity() const { return where.size(); }
+
+    void put(int key, const SpriteQuad &q) {
+        if (where[key] < 0) {
+            where[key] = (int)owner.size();
+            owner.push_back(key);
+            verts.resize(verts.size() + 4);
+        }
+        writeQuad(&verts[where[key] * 4], (float)q.x, (float)q.y, (float)q.w, (float)q.h, QuadColor(), q.u0, q.v0, q.u1, q.v1);
+    }
+
+    void erase(int key) {
+        int at = where[key];
+        if (at < 0) return;
+        int last = (int)owner.size() - 1;
+        if (at != last) {
+            for (int k = 0; k < 4; ++k) verts[at * 4 + k] = verts[last * 4 + k];
+            owner[at] = owner[last];
+            where[owner[at]] = at;
+        }
+        owner.pop_back();
+        verts.resize(verts.size() - 4);
+        where[key] = -1;
+    }
+
+    void draw(GLuint tex) const { if (!verts.empty()) drawVertices(&verts[0], (int)verts.size(), GL_QUADS, tex); }
+
+    // Only the quads of the listed keys that are in the pool.
+    void draw(GLuint tex, const std::vector<int> &keys, std::vector<GLuint> &scratch) const {
+        scratch.clear();
+        for (int key: keys)
+            if (where[key] >= 0) appendIndices(scratch, (size_t)where[key], 4);
+        if (!scratch.empty()) drawVertices(&verts[0], (int)scratch.size(), GL_QUADS, tex, 1.0f, &scratch[0]);
+    }
+
+private:
+    std::vector<int> where;
+    std::vector<int> owner;
+    std::vector<BatchVertex> verts;
+};
@@ -0,0 +1,350 @@
+// Headless throughput benchmark for ParkingLot.
+//
+//   g++ -O2 -std=c++17 bench.cpp -o bench
+//   ./bench [ops] [slots...]
+//
+// For every lot size it runs `ops` random park/remove operations and prints
+// ops/sec plus p50/p99 latency of a single operation, then the cost of one
+// update() tick and of batch-billing the whole lot. Add -mavx2 to get the
+// vectorized billing kernel. A second table pushes the same kind of traffic
+// through LotEngine from several producer threads at once, and a third times
+// a facility-wide tick and totals pass over a 40-level, 40k-bay facility on
+// one thread and on the whole pool. The next times nearest-free-slot
+// assignment from four entry points on a 90% full lot against a linear scan,
+// and the last single bills and whole-lot billing on per-type tariffs.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "facility.h"
+#include "lot_engine.h"
+#include "parking_core.h"
+
+using namespace std::chrono;
+
+struct BenchResult {
+    double opsPerSec;
+    double p50Ns, p99Ns;
+    double tickUs;
+    double billUs;
+    double projected;
+};
+
+static double percentile(std::vector<uint32_t> &v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static BenchResult runLot(int slotCount, long long ops, uint32_t seed) {
+    int cols = std::max(1, (int)std::sqrt((double)slotCount));
+    int rows = (slotCount + cols - 1) / cols;
+    ParkingLot lot;
+    lot.initGrid(cols, rows, 28, 28, 5, 8, cols * 33, rows * 36);
+
+    VehicleHandle fleet[3] = {
+        lot.vehicles().add(Vehicle(Vehicle::CAR, 0, 0, 0, "Car")),
+        lot.vehicles().add(Vehicle(Vehicle::BIKE, 0, 0, 0, "Bike")),
+        lot.vehicles().add(Vehicle(Vehicle::TRUCK, 0, 0, 0, "Truck")),
+    };
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pickSlot(0, (int)lot.size() - 1);
+    std::vector<int> targets((size_t)ops);
+    for (auto &t: targets) t = pickSlot(rng);
+
+    std::vector<uint32_t> lat((size_t)ops);
+    auto begin = steady_clock::now();
+    for (long long n = 0; n < ops; ++n) {
+        int i = targets[(size_t)n];
+        auto t0 = steady_clock::now();
+        if (lot.isParked(i)) lot.remove(i, t0);
+        else lot.park(i, fleet[n % 3], t0);
+        auto t1 = steady_clock::now();
+        lat[(size_t)n] = (uint32_t)duration_cast<nanoseconds>(t1 - t0).count();
+    }
+    double total = duration<double>(steady_clock::now() - begin).count();
+
+    auto t0 = steady_clock::now();
+    lot.update();
+    double tick = duration<double, std::micro>(steady_clock::now() - t0).count();
+
+    // Bill the whole lot as of a minute from now so penalties are non-zero.
+    auto billAt = steady_clock::now() + seconds(60);
+    t0 = steady_clock::now();
+    double projected = lot.projectedRevenue(billAt);
+    double bill = duration<double, std::micro>(steady_clock::now() - t0).count();
+
+    BenchResult r;
+    r.opsPerSec = ops / total;
+    r.p50Ns = percentile(lat, 0.50);
+    r.p99Ns = percentile(lat, 0.99);
+    r.tickUs = tick;
+    r.billUs = bill;
+    r.projected = projected;
+    return r;
+}
+
+// Commands per second through the engine with `producers` threads submitting
+// at once, counted until the engine has applied or rejected all of them.
+static void addFleet(Facility &f) {
+    f.addVehicle(Vehicle(Vehicle::CAR, 0, 0, 0, "Car"));
+    f.addVehicle(Vehicle(Vehicle::BIKE, 0, 0, 0, "Bike"));
+    f.addVehicle(Vehicle(Vehicle::TRUCK, 0, 0, 0, "Truck"));
+}
+
+static double runIngest(int slotCount, long long ops, int producers) {
+    int cols = std::max(1, (int)std::sqrt((double)slotCount));
+    int rows = (slotCount + cols - 1) / cols;
+    FacilityConfig cfg;
+    cfg.levels.push_back({ "L1", cols, rows, 28, 28, 5, 8 });
+    Facility facility;
+    facility.build(cfg, cols * 33, rows * 36);
+    addFleet(facility);
+
+    LotEngine engine(facility);
+    engine.start();
+    auto begin = steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            std::mt19937 rng(777u + p);
+            std::uniform_int_distribution<int> pickSlot(0, slotCount - 1);
+            long long mine = ops / producers + (p < ops % producers ? 1 : 0);
+            for (long long n = 0; n < mine; ++n) {
+                int i = pickSlot(rng);
+                LotCommand c = { (uint8_t)(n & 1 ? CMD_REMOVE : CMD_PARK), (uint8_t)(1 + n % 3), (uint16_t)(p + 1), 0, i };
+                while (!engine.submit(c)) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &t: threads) t.join();
+    while (engine.applied() + engine.rejected() < (uint64_t)ops) std::this_thread::yield();
+    double total = duration<double>(steady_clock::now() - begin).count();
+    engine.stop();
+    return ops / total;
+}
+
+struct FacilityResult {
+    double tickUs;
+    double totalsUs;
+};
+
+// Half-fills `levels` levels of `perLevel` bays, then times update() and
+// totals(), best of a few runs.
+static FacilityResult runFacility(int levels, int perLevel, unsigned workers) {
+    int cols = std::max(1, (int)std::sqrt((double)perLevel));
+    int rows = (perLevel + cols - 1) / cols;
+    FacilityConfig cfg;
+    for (int l = 0; l < levels; ++l) cfg.levels.push_back({ "L" + std::to_string(l + 1), cols, rows, 28, 28, 5, 8 });
+    Facility facility(workers);
+    facility.build(cfg, cols * 33, rows * 36);
+    addFleet(facility);
+    std::mt19937 rng(99u);
+    for (int l = 0; l < levels; ++l)
+        for (int i = 0; i < perLevel; i += 2) facility.park(l, i, (Vehicle::Type)(1 + rng() % 3));
+
+    FacilityResult r = { 1e30, 1e30 };
+    auto at = steady_clock::now() + seconds(60);
+    for (int rep = 0; rep < 20; ++rep) {
+        auto t0 = steady_clock::now();
+        facility.update();
+        auto t1 = steady_clock::now();
+        volatile double sink = facility.totals(at).projected;
+        (void)sink;
+        auto t2 = steady_clock::now();
+        r.tickUs = std::min(r.tickUs, duration<double, std::micro>(t1 - t0).count());
+        r.totalsUs = std::min(r.totalsUs, duration<double, std::micro>(t2 - t1).count());
+    }
+    return r;
+}
+
+struct AssignResult {
+    double p50Ns, p99Ns;
+    double scanNs;
+};
+
+// Keeps the lot 90% full: each step frees a random parked slot and assigns
+// the nearest free one to a random type from a random corner entry.
+static AssignResult runAssign(int slotCount, long long ops, uint32_t seed) {
+    int cols = std::max(1, (int)std::sqrt((double)slotCount));
+    int rows = (slotCount + cols - 1) / cols;
+    ParkingLot lot;
+    lot.initGrid(cols, rows, 28, 28, 5, 8, cols * 33, rows * 36);
+    lot.setEntries({ { 0, 0 }, { cols * 33, 0 }, { 0, rows * 36 }, { cols * 33, rows * 36 } });
+    for (int r = 0; r < rows; r += 4)      // every fourth row is for cars only
+        for (int c = 0; c < cols; ++c) lot.setAccepts(r * cols + c, typeBit(Vehicle::CAR));
+    VehicleHandle fleet[3] = {
+        lot.vehicles().add(Vehicle(Vehicle::CAR, 0, 0, 0, "Car")),
+        lot.vehicles().add(Vehicle(Vehicle::BIKE, 0, 0, 0, "Bike")),
+        lot.vehicles().add(Vehicle(Vehicle::TRUCK, 0, 0, 0, "Truck")),
+    };
+
+    std::mt19937 rng(seed);
+    std::vector<int> parked;
+    auto now = steady_clock::now();
+    while (parked.size() < lot.size() * 9 / 10) {
+        int i = lot.nearestFree(Vehicle::CAR, rng() % 4);
+        if (i < 0 || !lot.park(i, fleet[0], now)) break;
+        parked.push_back(i);
+    }
+
+    std::vector<uint32_t> lat;
+    lat.reserve((size_t)ops);
+    for (long long n = 0; n < ops && !parked.empty(); ++n) {
+        size_t k = rng() % parked.size();
+        lot.remove(parked[k], now);
+        int t = 1 + (int)(rng() % 3);
+        auto t0 = steady_clock::now();
+        int i = lot.nearestFree((Vehicle::Type)t, rng() % 4);
+        auto t1 = steady_clock::now();
+        lat.push_back((uint32_t)duration_cast<nanoseconds>(t1 - t0).count());
+        if (i >= 0 && lot.park(i, fleet[t - 1], now)) parked[k] = i;
+        else { parked[k] = parked.back(); parked.pop_back(); }
+    }
+
+    // The same question answered by walking every slot.
+    const SlotStore &store = lot.columns();
+    const EntryPoint &e = lot.entries()[0];
+    int reps = 200;
+    volatile int sink = 0;
+    auto t0 = steady_clock::now();
+    for (int rep = 0; rep < reps; ++rep) {
+        int best = -1;
+        long long bestD = 0;
+        for (size_t i = 0; i < lot.size(); ++i) {
+            if (lot.isParked(i) || !(store.accepts[i] & typeBit(Vehicle::TRUCK))) continue;
+            const Rect &r = store.rect[i];
+            long long dx = 2LL * r.x + r.w - 2LL * e.x, dy = 2LL * r.y + r.h - 2LL * e.y;
+            if (best < 0 || dx * dx + dy * dy < bestD) { best = (int)i; bestD = dx * dx + dy * dy; }
+        }
+        sink = best;
+    }
+    (void)sink;
+    double scan = duration<double, std::nano>(steady_clock::now() - t0).count() / reps;
+    return { percentile(lat, 0.50), percentile(lat, 0.99), scan };
+}
+
+struct TariffResult {
+    double billNs;
+    double builtinUs, mixedUs;
+};
+
+// Half-fills a lot with a random mix of types, then times whole-lot billing
+// on the built-in tariff and on a different multi-step tariff per type, and
+// a single bill on the latter, best of a few runs.
+static TariffResult runTariffs(int slotCount, uint32_t seed) {
+    int cols = std::max(1, (int)std::sqrt((double)slotCount));
+    int rows = (slotCount + cols - 1) / cols;
+    ParkingLot lot;
+    lot.initGrid(cols, rows, 28, 28, 5, 8, cols * 33, rows * 36);
+    VehicleHandle fleet[3] = {
+        lot.vehicles().add(Vehicle(Vehicle::CAR, 0, 0, 0, "Car")),
+        lot.vehicles().add(Vehicle(Vehicle::BIKE, 0, 0, 0, "Bike")),
+        lot.vehicles().add(Vehicle(Vehicle::TRUCK, 0, 0, 0, "Truck")),
+    };
+    std::mt19937 rng(seed);
+    auto now = steady_clock::now();
+    for (size_t i = 0; i < lot.size(); i += 2) lot.park((int)i, fleet[rng() % 3], now);
+
+    std::vector<TariffRule> rules;
+    for (int t = 1; t <= 3; ++t) {
+        TariffRule r;
+        r.types = typeBit((Vehicle::Type)t);
+        r.basePaisa = toPaisa(20.0 * t);
+        for (int k = 1; k <= t + 1; ++k) r.steps.push_back({ 15 * k, 10 * k * t, k == 3 ? toPaisa(50) : 0 });
+        rules.push_back(r);
+    }
+    TariffTable mixed;
+    mixed.compile(rules, "L1", 0);
+
+    TariffResult r = { 1e30, 1e30, 1e30 };
+    auto at = now + seconds(60);
+    std::vector<int32_t> bills(lot.size());
+    for (int rep = 0; rep < 10; ++rep) {
+        auto t0 = steady_clock::now();
+        lot.billAll(at, bills.data());
+        r.builtinUs = std::min(r.builtinUs, duration<double, std::micro>(steady_clock::now() - t0).count());
+    }
+    lot.setTariffs(mixed);
+    for (int rep = 0; rep < 10; ++rep) {
+        auto t0 = steady_clock::now();
+        lot.billAll(at, bills.data());
+        r.mixedUs = std::min(r.mixedUs, duration<double, std::micro>(steady_clock::now() - t0).count());
+    }
+
+    const int calls = 1 << 20;
+    std::vector<int32_t> secs(4096);
+    for (auto &v: secs) v = (int32_t)(rng() % 600);
+    int64_t sink = 0;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto t0 = steady_clock::now();
+        for (int c = 0; c < calls; ++c) sink += mixed.billPaisa((uint8_t)(1 + c % 3), secs[c & 4095]);
+        r.billNs = std::min(r.billNs, duration<double, std::nano>(steady_clock::now() - t0).count() / calls);
+    }
+    volatile int64_t keep = sink;
+    (void)keep;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    long long ops = 5000000;
+    std::vector<int> sizes;
+    if (argc > 1) ops = std::atoll(argv[1]);
+    for (int a = 2; a < argc; ++a) sizes.push_back(std::atoi(argv[a]));
+    if (sizes.empty()) sizes = {10000, 100000, 1000000};
+
+    std::cout << std::left << std::setw(10) << "slots" << std::setw(14) << "ops/sec"
+              << std::setw(10) << "p50(ns)" << std::setw(10) << "p99(ns)" << std::setw(10) << "tick(us)"
+              << std::setw(10) << "bill(us)" << "projected(Tk)\n";
+    for (int n: sizes) {
+        BenchResult r = runLot(n, ops, 12345u + (uint32_t)n);
+        std::cout << std::left << std::setw(10) << n
+                  << std::setw(14) << std::fixed << std::setprecision(0) << r.opsPerSec
+                  << std::setw(10) << r.p50Ns << std::setw(10) << r.p99Ns
+                  << std::setprecision(1) << std::setw(10) << r.tickUs << std::setw(10) << r.billUs
+                  << std::setprecision(0) << r.projected << "\n";
+    }
+
+    std::cout << "\n" << std::left << std::setw(10) << "slots" << std::setw(12) << "producers" << "cmds/sec\n";
+    for (int n: sizes) {
+        for (int producers: {1, 4, 8}) {
+            double rate = runIngest(n, ops, producers);
+            std::cout << std::left << std::setw(10) << n << std::setw(12) << producers
+                      << std::fixed << std::setprecision(0) << rate << "\n";
+        }
+    }
+
+    std::cout << "\n" << std::left << std::setw(10) << "levels" << std::setw(10) << "bays" << std::setw(10) << "threads"
+              << std::setw(10) << "tick(us)" << "totals(us)\n";
+    for (unsigned workers: {0u, ThreadPool::defaultWorkers()}) {
+        FacilityResult r = runFacility(40, 1000, workers);
+        std::cout << std::left << std::setw(10) << 40 << std::setw(10) << 40000 << std::setw(10) << workers + 1
+                  << std::fixed << std::setprecision(1) << std::setw(10) << r.tickUs << r.totalsUs << "\n";
+    }
+
+    std::cout << "\n" << std::left << std::setw(10) << "slots" << std::setw(14) << "assign p50" << std::setw(14)
+              << "assign p99" << "scan(ns)\n";
+    for (int n: sizes) {
+        AssignResult r = runAssign(n, std::min(ops, 1000000LL), 4242u + (uint32_t)n);
+        std::cout << std::left << std::setw(10) << n << std::fixed << std::setprecision(0) << std::setw(14) << r.p50Ns
+                  << std::setw(14) << r.p99Ns << r.scanNs << "\n";
+    }
+
+    std::cout << "\n" << std::left << std::setw(10) << "slots" << std::setw(10) << "bill(ns)" << std::setw(14)
+              << "builtin(us)" << "per-type(us)\n";
+    for (int n: sizes) {
+        TariffResult r = runTariffs(n, 31337u + (uint32_t)n);
+        std::cout << std::left << std::setw(10) << n << std::fixed << std::setprecision(1) << std::setw(10) << r.billNs
+                  << std::setw(14) << r.builtinUs << r.mixedUs << "\n";
+    }
+    return 0;
+}
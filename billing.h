@@ -0,0 +1,466 @@
+// Billing rules, tariff tables and the batch billing kernel.
+//
+// A tariff prices a stay by its whole seconds: a flat price up to the first
+// step, then from each step on a rate per second, plus an optional one-off
+// charge on reaching it. Tariffs are chosen per vehicle type and arrival
+// time of day, and read from config (see loadFacilityConfig); without any
+// the built-in rule below applies. TariffTable compiles them into flat
+// arrays: the plan for each (type, minute of day), and per plan its
+// segments plus buckets of 2^shift seconds, each naming the segment it
+// starts in. A bucket is no longer than the shortest segment, so a bill is
+// a shift, a bucket read, one compare against the next segment's start and
+// a multiply-add, with no search or branch. Plans of up to eight segments
+// are also kept padded to eight, for runs of slots on one plan in billAll.
+//
+// Money in the batch path is fixed point: int32 paisa (1/100 Tk) per slot,
+// saturating at INT32_MAX (about 21.4M Tk), and int64 for totals. Time is
+// whole seconds relative to the lot epoch, with the sub-second part kept in
+// a separate column, so the whole elapsed seconds of a stay is
+// (nowSec - startSec) minus one if nowSub < startSub. That is exact, and it
+// is plain int32 arithmetic, which vectorizes.
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Built-in tariff, and the stay after which a vehicle counts as overstaying
+// whatever its tariff.
+const int MAX_SECONDS = 30;
+const double MIN_FIRST_MIN_TK = 100.0;
+const double PENALTY_PER_EXTRA_SEC = 1.0;
+
+inline int32_t toPaisa(double tk) { return (int32_t)std::lround(tk * 100); }
+
+// From fromSec on, ratePaisa per second, plus jumpPaisa once on reaching it.
+// Both are >= 0.
+struct TariffStep {
+    int32_t fromSec;
+    int32_t ratePaisa;
+    int32_t jumpPaisa;
+};
+
+const int DAY_MINUTES = 24 * 60;
+
+// Arrivals on `level` ("*": every level) of the types in `types` (bit per
+// Vehicle::Type) from fromMin to toMin minutes past local midnight, wrapping
+// past it; equal bounds mean the whole day. steps rise strictly, from > 0.
+struct TariffRule {
+    std::string level = "*";
+    uint8_t types = 0;
+    int fromMin = 0, toMin = 0;
+    int32_t basePaisa = 0;
+    std::vector<TariffStep> steps;
+};
+
+inline TariffRule builtinTariff() {
+    TariffRule r;
+    r.types = 0xFF;
+    r.basePaisa = toPaisa(MIN_FIRST_MIN_TK);
+    r.steps.push_back({ MAX_SECONDS, toPaisa(PENALTY_PER_EXTRA_SEC), 0 });
+    return r;
+}
+
+// Minutes east of UTC of the machine's local time, right now.
+inline int localUtcOffsetMin() {
+    std::time_t t = std::time(nullptr);
+    std::tm local = *std::localtime(&t);
+    std::tm utc = *std::gmtime(&t);
+    int days = local.tm_yday - utc.tm_yday;
+    if (days > 1) days = -1;          // across New Year
+    else if (days < -1) days = 1;
+    return days * DAY_MINUTES + (local.tm_hour - utc.tm_hour) * 60 + (local.tm_min - utc.tm_min);
+}
+
+struct BillTotals {
+    int occupied = 0;
+    int overstayed = 0;                // charged above their tariff's flat price
+    int64_t basePaisa = 0;
+    int64_t penaltyPaisa = 0;
+
+    int64_t totalPaisa() const { return basePaisa + penaltyPaisa; }
+    double totalTk() const { return totalPaisa() / 100.0; }
+};
+
+class TariffTable {
+public:
+    static const int TYPES = 4;        // indexed by Vehicle::Type; 0 is unused
+    static const int MAX_PLANS = 256;  // plan ids are one byte
+
+    TariffTable() { compile({}, "*", 0); }
+
+    // The built-in rule, then every rule for `level` in order, later ones
+    // winning where they overlap; rules past MAX_PLANS - 1 are dropped.
+    // Local midnight is utcOffsetMin after UTC midnight.
+    void compile(const std::vector<TariffRule> &rules, const std::string &level, int utcOffsetMin) {
+        plans.clear(); shortPlans.clear(); bucketSeg.clear();
+        segStart.clear(); segBase.clear(); segRate.clear(); segSpan.clear();
+        offsetMin = utcOffsetMin;
+        addPlan(builtinTariff());
+        std::fill(&planOf[0][0], &planOf[0][0] + TYPES * DAY_MINUTES, 0);
+        for (const TariffRule &r: rules) {
+            if ((r.level != "*" && r.level != level) || plans.size() >= MAX_PLANS) continue;
+            uint8_t id = (uint8_t)plans.size();
+            addPlan(r);
+            int from = ((r.fromMin % DAY_MINUTES) + DAY_MINUTES) % DAY_MINUTES;
+            int to = ((r.toMin % DAY_MINUTES) + DAY_MINUTES) % DAY_MINUTES;
+            for (int t = 1; t < TYPES; ++t) {
+                if (!(r.types >> t & 1)) continue;
+                int m = from;
+                do { planOf[t][m] = id; m = (m + 1) % DAY_MINUTES; } while (m != to);
+            }
+        }
+        timeOfDay = false;
+        for (int t = 1; t < TYPES; ++t)
+            timeOfDay |= std::any_of(planOf[t], planOf[t] + DAY_MINUTES, [&](uint8_t p) { return p != planOf[t][0]; });
+
+        lanes.segments = 0;
+        if (plans.size() <= 8 && std::all_of(shortPlans.begin(), shortPlans.end(), [](const ShortPlan &q) { return q.segments > 0; })) {
+            for (size_t p = 0; p < 8; ++p) {
+                const ShortPlan &q = shortPlans[p < plans.size() ? p : 0];
+                lanes.segments = std::max(lanes.segments, q.segments);
+                for (int j = 0; j < 8; ++j) {
+                    lanes.start[j][p] = q.start[j];
+                    lanes.base[j][p] = q.base[j];
+                    lanes.rate[j][p] = q.rate[j];
+                }
+                int64_t last = INT32_MAX;
+                for (int j = 0; j < q.segments; ++j) {
+                    int64_t end = (int64_t)q.start[j] + q.span[j];
+                    if (end < (j + 1 < q.segments ? q.start[j + 1] : INT32_MAX)) { last = end; break; }
+                }
+                lanes.lastSec[p] = (int32_t)last;
+            }
+        }
+
+        uint8_t only = planOf[1][0];
+        bool single = true;
+        for (int t = 1; t < TYPES; ++t)
+            single &= std::all_of(planOf[t], planOf[t] + DAY_MINUTES, [&](uint8_t p) { return p == only; });
+        priceText = single ? "Price: " + describe(only) : timeOfDay ? "Prices by vehicle and arrival time" : "Prices by vehicle type";
+    }
+
+    size_t planCount() const { return plans.size(); }
+
+    // Whether the plan depends on the arrival time, not just the type.
+    bool byTimeOfDay() const { return timeOfDay; }
+
+    // Plan for a vehicle of `type` arriving at wall time wallNs.
+    uint8_t planFor(int type, int64_t wallNs) const {
+        if (type <= 0 || type >= TYPES) return 0;
+        int64_t minute = wallNs / 60000000000LL - (wallNs < 0 && wallNs % 60000000000LL != 0) + offsetMin;
+        return planOf[type][(int)(((minute % DAY_MINUTES) + DAY_MINUTES) % DAY_MINUTES)];
+    }
+
+    int32_t billPaisa(uint8_t plan, int32_t wholeSeconds) const {
+        const Plan &p = plans[plan < plans.size() ? plan : 0];
+        int32_t s = std::max(wholeSeconds, 0);
+        int32_t k = bucketSeg[p.firstBucket + std::min(s >> p.shift, p.lastBucket)];
+        k += s >= segStart[k + 1];
+        int32_t d = s - segStart[k];
+        return d > segSpan[k] ? INT32_MAX : segBase[k] + d * segRate[k];
+    }
+
+    // Same on a fractional stay: a part second is not charged.
+    double bill(uint8_t plan, double elapsedSec) const {
+        double s = std::floor(std::min(std::max(elapsedSec, 0.0), (double)INT32_MAX));
+        return billPaisa(plan, (int32_t)s) / 100.0;
+    }
+
+    int32_t basePaisa(uint8_t plan) const { return plans[plan < plans.size() ? plan : 0].basePaisa; }
+
+    // Seconds a stay on `plan` is charged only its flat price; INT32_MAX if
+    // it never costs more.
+    int32_t flatSeconds(uint8_t plan) const {
+        int32_t k = firstSeg(plan);
+        for (; segStart[k] != INT32_MAX; ++k)
+            if (segRate[k] > 0 || (segStart[k] > 0 && segBase[k] > segBase[k - 1] + (int64_t)(segStart[k] - segStart[k - 1]) * segRate[k - 1]))
+                return segStart[k];
+        return INT32_MAX;
+    }
+
+    // The plan's prices, e.g. "100 Tk, +1 Tk/s after 30 s".
+    std::string describe(uint8_t plan) const {
+        int32_t k = firstSeg(plan);
+        std::string out = tk(segBase[k]) + " Tk";
+        if (segRate[k] > 0) out += ", +" + tk(segRate[k]) + " Tk/s";
+        for (++k; segStart[k] != INT32_MAX; ++k) {
+            int64_t jump = segBase[k] - (segBase[k - 1] + (int64_t)(segStart[k] - segStart[k - 1]) * segRate[k - 1]);
+            out += ", ";
+            if (jump > 0) out += "+" + tk(jump) + " Tk and ";
+            out += "+" + tk(segRate[k]) + " Tk/s after " + std::to_string(segStart[k]) + " s";
+        }
+        return out;
+    }
+
+    // One line for the HUD: the price if every arrival pays the same plan.
+    const std::string &summary() const { return priceText; }
+
+    // Bills every slot whose flags have parkedBit set, as of (nowSec, nowSub),
+    // on the plan in its plan column. bills (optional) receives paisa per
+    // slot, 0 for empty slots.
+    BillTotals billAll(const int32_t *startSec, const int32_t *startSub, const uint8_t *flags, const uint8_t *plan,
+                       size_t n, uint8_t parkedBit, int32_t nowSec, int32_t nowSub, int32_t *bills) const {
+        BillTotals t;
+        size_t i = 0;
+        // Locals, not t: t could alias bills as far as the compiler knows.
+        int occupied = 0, overstayed = 0;
+        int64_t base = 0, penalty = 0;
+#if defined(__AVX2__)
+        const __m256i vNowSec = _mm256_set1_epi32(nowSec), vNowSub = _mm256_set1_epi32(nowSub);
+        const __m256i vZero = _mm256_setzero_si256(), vBit = _mm256_set1_epi32(parkedBit);
+        const __m256i vPlanCount = _mm256_set1_epi32((int)plans.size()), vMax = _mm256_set1_epi32(INT32_MAX);
+        const int *planInts = &plans[0].shift;
+        const int laneSegments = lanes.segments;
+        __m256i baseLo = vZero, baseHi = vZero, penLo = vZero, penHi = vZero;
+        auto load = [&](size_t at, __m256i &parked, __m256i &s) {
+            __m256i f = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(flags + at)));
+            parked = _mm256_cmpeq_epi32(_mm256_and_si256(f, vBit), vBit);
+            __m256i sec = _mm256_loadu_si256((const __m256i *)(startSec + at));
+            __m256i sub = _mm256_loadu_si256((const __m256i *)(startSub + at));
+            // cmpgt yields -1 where the sub-second part has not caught up yet.
+            __m256i whole = _mm256_add_epi32(_mm256_sub_epi32(vNowSec, sec), _mm256_cmpgt_epi32(sub, vNowSub));
+            s = _mm256_max_epi32(whole, vZero);
+        };
+        auto store = [&](size_t at, __m256i parked, __m256i bill, __m256i flatPaisa) {
+            bill = _mm256_and_si256(bill, parked);
+            if (bills) _mm256_storeu_si256((__m256i *)(bills + at), bill);
+            __m256i pen = _mm256_sub_epi32(bill, flatPaisa);
+            penLo = _mm256_add_epi64(penLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(pen)));
+            penHi = _mm256_add_epi64(penHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(pen, 1)));
+            int pm = _mm256_movemask_ps(_mm256_castsi256_ps(parked));
+            int om = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pen, vZero)));
+            for (; pm; pm &= pm - 1) ++occupied;
+            for (; om; om &= om - 1) ++overstayed;
+        };
+        // INT32_MAX where d is past span, so the multiply-add may have wrapped.
+        auto saturate = [&](__m256i bill, __m256i d, __m256i span) {
+            return _mm256_blendv_epi8(bill, vMax, _mm256_cmpgt_epi32(d, span));
+        };
+        auto blockAt = [&](size_t at) { uint64_t b; std::memcpy(&b, plan + at, sizeof b); return b; };
+
+        while (i + 8 <= n) {
+            uint64_t block = blockAt(i);
+            const ShortPlan &sp = shortPlan(plan[i]);
+            if (block == plan[i] * 0x0101010101010101ull && sp.segments) {
+                // A run of blocks all on one short plan: its segments sit in
+                // registers, the segment is a count of starts passed, and the
+                // flat price is summed from the occupied count.
+                const __m256i start = _mm256_loadu_si256((const __m256i *)sp.start);
+                const __m256i bases = _mm256_loadu_si256((const __m256i *)sp.base);
+                const __m256i rate = _mm256_loadu_si256((const __m256i *)sp.rate);
+                const __m256i span = _mm256_loadu_si256((const __m256i *)sp.span);
+                const __m256i second = _mm256_set1_epi32(sp.start[1] - 1);
+                const __m256i flatPaisa = _mm256_set1_epi32(sp.base[0]);
+                const int segments = sp.segments;
+                int before = occupied;
+                do {
+                    __m256i parked, s;
+                    load(i, parked, s);
+                    __m256i k = _mm256_sub_epi32(vZero, _mm256_cmpgt_epi32(s, second));
+                    for (int j = 2; j < segments; ++j)
+                        k = _mm256_sub_epi32(k, _mm256_cmpgt_epi32(s, _mm256_set1_epi32(sp.start[j] - 1)));
+                    __m256i d = _mm256_sub_epi32(s, _mm256_permutevar8x32_epi32(start, k));
+                    __m256i bill = _mm256_add_epi32(_mm256_permutevar8x32_epi32(bases, k),
+                                                    _mm256_mullo_epi32(d, _mm256_permutevar8x32_epi32(rate, k)));
+                    bill = saturate(bill, d, _mm256_permutevar8x32_epi32(span, k));
+                    store(i, parked, bill, _mm256_and_si256(flatPaisa, parked));
+                    i += 8;
+                } while (i + 8 <= n && blockAt(i) == block);
+                base += (int64_t)(occupied - before) * sp.base[0];
+                continue;
+            }
+            __m256i parked, s;
+            load(i, parked, s);
+            __m256i pl = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(plan + i)));
+            pl = _mm256_and_si256(pl, _mm256_cmpgt_epi32(vPlanCount, pl));
+
+            if (laneSegments) {
+                // Mixed blocks on a table of few short plans, as per-type
+                // tariffs give: walk the segments, taking each lane's
+                // values from the plan-indexed rows.
+                auto row = [&](const int32_t *r) { return _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)r), pl); };
+                __m256i from = row(lanes.start[0]), segB = row(lanes.base[0]), rate = row(lanes.rate[0]);
+                __m256i flatPaisa = _mm256_and_si256(segB, parked);
+                for (int j = 1; j < laneSegments; ++j) {
+                    __m256i st = row(lanes.start[j]);
+                    __m256i before = _mm256_cmpgt_epi32(st, s);
+                    from = _mm256_blendv_epi8(st, from, before);
+                    segB = _mm256_blendv_epi8(row(lanes.base[j]), segB, before);
+                    rate = _mm256_blendv_epi8(row(lanes.rate[j]), rate, before);
+                }
+                __m256i d = _mm256_sub_epi32(s, from);
+                // Bills only grow, so past a plan's last second they stay saturated.
+                __m256i bill = saturate(_mm256_add_epi32(segB, _mm256_mullo_epi32(d, rate)), s, row(lanes.lastSec));
+                baseLo = _mm256_add_epi64(baseLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(flatPaisa)));
+                baseHi = _mm256_add_epi64(baseHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(flatPaisa, 1)));
+                store(i, parked, bill, flatPaisa);
+                i += 8;
+                continue;
+            }
+
+            // Plan fields are four ints apart; see Plan.
+            __m256i at = _mm256_slli_epi32(pl, 2);
+            __m256i shift = _mm256_i32gather_epi32(planInts, at, 4);
+            __m256i first = _mm256_i32gather_epi32(planInts + 1, at, 4);
+            __m256i last = _mm256_i32gather_epi32(planInts + 2, at, 4);
+            __m256i flatPaisa = _mm256_and_si256(_mm256_i32gather_epi32(planInts + 3, at, 4), parked);
+            __m256i bucket = _mm256_add_epi32(first, _mm256_min_epi32(_mm256_srlv_epi32(s, shift), last));
+            __m256i k = _mm256_i32gather_epi32(bucketSeg.data(), bucket, 4);
+            __m256i next = _mm256_i32gather_epi32(segStart.data() + 1, k, 4);
+            k = _mm256_sub_epi32(k, _mm256_or_si256(_mm256_cmpgt_epi32(s, next), _mm256_cmpeq_epi32(s, next)));
+            __m256i d = _mm256_sub_epi32(s, _mm256_i32gather_epi32(segStart.data(), k, 4));
+            __m256i bill = _mm256_add_epi32(_mm256_i32gather_epi32(segBase.data(), k, 4),
+                                            _mm256_mullo_epi32(d, _mm256_i32gather_epi32(segRate.data(), k, 4)));
+            bill = saturate(bill, d, _mm256_i32gather_epi32(segSpan.data(), k, 4));
+            baseLo = _mm256_add_epi64(baseLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(flatPaisa)));
+            baseHi = _mm256_add_epi64(baseHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(flatPaisa, 1)));
+            store(i, parked, bill, flatPaisa);
+            i += 8;
+        }
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256((__m256i *)lanes, _mm256_add_epi64(baseLo, baseHi));
+        base += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm256_store_si256((__m256i *)lanes, _mm256_add_epi64(penLo, penHi));
+        penalty += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+        while (i < n) {
+            size_t end = i + 1;
+            while (end < n && plan[end] == plan[i]) ++end;
+            const ShortPlan sp = shortPlan(plan[i]);
+            if (sp.segments) {
+                // The run's segments are in sp; count the starts passed.
+                for (; i < end; ++i) {
+                    int32_t parked = (flags[i] & parkedBit) ? 1 : 0;
+                    int32_t whole = (nowSec - startSec[i]) - (startSub[i] > nowSub ? 1 : 0);
+                    int32_t s = whole > 0 ? whole : 0;
+                    int k = 0;
+                    for (int j = 1; j < sp.segments; ++j) k += s >= sp.start[j];
+                    int32_t d = s - sp.start[k];
+                    int32_t bill = (d > sp.span[k] ? INT32_MAX : sp.base[k] + d * sp.rate[k]) * parked;
+                    int32_t flat = sp.base[0] * parked;
+                    if (bills) bills[i] = bill;
+                    occupied += parked;
+                    overstayed += bill > flat;
+                    base += flat;
+                    penalty += bill - flat;
+                }
+            }
+            for (; i < end; ++i) {
+                int32_t parked = (flags[i] & parkedBit) ? 1 : 0;
+                int32_t whole = (nowSec - startSec[i]) - (startSub[i] > nowSub ? 1 : 0);
+                int32_t bill = billPaisa(plan[i], whole) * parked;
+                int32_t flat = basePaisa(plan[i]) * parked;
+                if (bills) bills[i] = bill;
+                occupied += parked;
+                overstayed += bill > flat;
+                base += flat;
+                penalty += bill - flat;
+            }
+        }
+        t.occupied = occupied;
+        t.overstayed = overstayed;
+        t.basePaisa = base;
+        t.penaltyPaisa = penalty;
+        return t;
+    }
+
+private:
+    // Four ints, in this order, for the kernel's gathers.
+    struct Plan {
+        int32_t shift;                 // bucket is 2^shift seconds
+        int32_t firstBucket;           // into bucketSeg
+        int32_t lastBucket;            // longer stays use this one
+        int32_t basePaisa;
+    };
+    static_assert(sizeof(Plan) == 4 * sizeof(int32_t), "Plan is gathered as ints");
+
+    // The same segments again for plans with at most eight, padded, so the
+    // AVX2 kernel can keep one in registers; segments is 0 for longer ones.
+    struct ShortPlan {
+        int32_t start[8], base[8], rate[8], span[8];
+        int32_t segments;
+    };
+
+    const ShortPlan &shortPlan(uint8_t plan) const { return shortPlans[plan < plans.size() ? plan : 0]; }
+    int32_t firstSeg(uint8_t plan) const { const Plan &p = plans[plan < plans.size() ? plan : 0]; return bucketSeg[p.firstBucket]; }
+
+    static std::string tk(int64_t paisa) {
+        char buf[32];
+        if (paisa % 100 == 0) snprintf(buf, sizeof buf, "%lld", (long long)(paisa / 100));
+        else snprintf(buf, sizeof buf, paisa % 10 == 0 ? "%.1f" : "%.2f", paisa / 100.0);
+        return buf;
+    }
+
+    // With at most eight plans, all short, the short plans transposed:
+    // [segment][plan], so a lane's values are a permute by its plan id.
+    // segments is the longest plan's count, or 0 when this does not apply.
+    struct PlanLanes {
+        int32_t start[8][8], base[8][8], rate[8][8];
+        int32_t lastSec[8];            // per plan, the last second billed below INT32_MAX
+        int32_t segments = 0;
+    };
+
+    std::vector<Plan> plans;
+    std::vector<ShortPlan> shortPlans;
+    PlanLanes lanes;
+    std::vector<int32_t> bucketSeg;    // segment a bucket starts in
+    std::vector<int32_t> segStart, segBase, segRate;   // per plan: segments, then a sentinel start
+    std::vector<int32_t> segSpan;      // seconds into a segment before the bill passes INT32_MAX
+
+    static int32_t spanOf(int32_t base, int32_t rate) { return rate > 0 ? (INT32_MAX - base) / rate : INT32_MAX; }
+    static int32_t addSat(int64_t a, int64_t b) { return (int32_t)std::min<int64_t>(a + b, INT32_MAX); }
+    uint8_t planOf[TYPES][DAY_MINUTES];
+    int offsetMin = 0;
+    bool timeOfDay = false;
+    std::string priceText;
+
+    void addPlan(const TariffRule &r) {
+        int32_t first = (int32_t)segStart.size();
+        segStart.push_back(0); segBase.push_back(r.basePaisa); segRate.push_back(0);
+        for (const TariffStep &st: r.steps) {
+            int32_t k = (int32_t)segStart.size() - 1;
+            if (st.fromSec <= segStart[k]) { segBase[k] = addSat(segBase[k], st.jumpPaisa); segRate[k] = st.ratePaisa; continue; }
+            segBase.push_back(addSat(segBase[k] + (int64_t)(st.fromSec - segStart[k]) * segRate[k], st.jumpPaisa));
+            segStart.push_back(st.fromSec);
+            segRate.push_back(st.ratePaisa);
+        }
+        int32_t last = (int32_t)segStart.size() - 1;
+        int32_t shortest = INT32_MAX;
+        for (int32_t k = first; k < last; ++k) shortest = std::min(shortest, segStart[k + 1] - segStart[k]);
+        int32_t shift = 0;
+        while (shift < 30 && (2LL << shift) <= shortest) ++shift;
+        segStart.push_back(INT32_MAX); segBase.push_back(0); segRate.push_back(0);
+        for (int32_t k = first; k <= last + 1; ++k) segSpan.push_back(spanOf(segBase[k], segRate[k]));
+
+        Plan p = { shift, (int32_t)bucketSeg.size(), segStart[last] >> shift, segBase[first] };
+        for (int32_t b = 0, k = first; b <= p.lastBucket; ++b) {
+            while (k < last && segStart[k + 1] <= (b << shift)) ++k;
+            bucketSeg.push_back(k);
+        }
+        plans.push_back(p);
+
+        ShortPlan sp = {};
+        int32_t count = last - first + 1;
+        sp.segments = count <= 8 ? count : 0;
+        for (int32_t j = 0; j < 8; ++j) {
+            int32_t k = first + std::min(j, count - 1);
+            sp.start[j] = j < count ? segStart[k] : INT32_MAX;
+            sp.base[j] = segBase[k];
+            sp.rate[j] = segRate[k];
+            sp.span[j] = segSpan[k];
+        }
+        shortPlans.push_back(sp);
+    }
+};
@@ -0,0 +1,59 @@
+// 2D view onto a level: screen = world * zoom + offset, in the UI's logical
+// pixels. GL-free; ParkingManager loads it into the modelview matrix for the
+// slot meshes and maps mouse positions back through it.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "spatial_index.h"
+
+struct Camera {
+    static constexpr float MIN_ZOOM = 0.02f;
+    static constexpr float MAX_ZOOM = 8.0f;
+
+    float zoom = 1.0f;
+    float offX = 0.0f, offY = 0.0f;
+
+    bool isIdentity() const { return zoom == 1.0f && offX == 0.0f && offY == 0.0f; }
+
+    float screenX(float wx) const { return wx * zoom + offX; }
+    float screenY(float wy) const { return wy * zoom + offY; }
+    int worldX(int sx) const { return (int)std::floor((sx - offX) / zoom); }
+    int worldY(int sy) const { return (int)std::floor((sy - offY) / zoom); }
+
+    Rect toScreen(const Rect &w) const {
+        int x0 = (int)std::lround(screenX((float)w.x)), y0 = (int)std::lround(screenY((float)w.y));
+        int x1 = (int)std::lround(screenX((float)(w.x + w.w))), y1 = (int)std::lround(screenY((float)(w.y + w.h)));
+        return { x0, y0, x1 - x0, y1 - y0 };
+    }
+
+    // World area covering the screen rect s, rounded outwards.
+    Rect toWorld(const Rect &s) const {
+        int x0 = worldX(s.x), y0 = worldY(s.y);
+        int x1 = (int)std::ceil((s.x + s.w - offX) / zoom), y1 = (int)std::ceil((s.y + s.h - offY) / zoom);
+        return { x0, y0, x1 - x0, y1 - y0 };
+    }
+
+    // Scales by factor about screen point (sx, sy), which stays put.
+    void zoomAt(float sx, float sy, float factor) {
+        float z = std::max(MIN_ZOOM, std::min(MAX_ZOOM, zoom * factor));
+        offX = sx - (sx - offX) * (z / zoom);
+        offY = sy - (sy - offY) * (z / zoom);
+        zoom = z;
+    }
+
+    void pan(float dx, float dy) { offX += dx; offY += dy; }
+
+    // Identity if `world` already lies inside `screen`, otherwise the zoom
+    // that shows all of it, centred.
+    void fit(const Rect &world, const Rect &screen) {
+        zoom = 1.0f; offX = offY = 0.0f;
+        if (world.x >= screen.x && world.y >= screen.y && world.x + world.w <= screen.x + screen.w &&
+            world.y + world.h <= screen.y + screen.h) return;
+        float z = std::min((float)screen.w / std::max(1, world.w), (float)screen.h / std::max(1, world.h));
+        zoom = std::max(MIN_ZOOM, std::min(1.0f, z));
+        offX = screen.x + (screen.w - world.w * zoom) / 2 - world.x * zoom;
+        offY = screen.y + (screen.h - world.h * zoom) / 2 - world.y * zoom;
+    }
+};
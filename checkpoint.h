@@ -0,0 +1,371 @@
+// Binary checkpoints of the whole facility, for restarts that do not replay
+// the day's log.
+//
+// A checkpoint holds every level's state columns (flags, vehicle handles,
+// start times), its collected total, the history rollups and how many event
+// log records all that includes. The engine cuts one from the immutable
+// snapshot it publishes anyway, so taking it copies only pointers to the
+// history's rollup blocks and never holds up the UI; CheckpointWriter
+// serialises it on its own thread into a temp file and renames that over
+// the previous checkpoint once the log is on disk up to the cut. At startup
+// the file is memory-mapped, the columns are copied straight into the lots
+// and only the log records after the cut are replayed.
+//
+// File: CheckpointHeader, the handle -> Vehicle::Type table, per level a
+// CheckpointLevel and its four columns, the history block if any, then a
+// CRC-32 of everything before it. Sections are padded to 8 bytes so the
+// columns can be read in place from the mapping.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "event_log.h"
+#include "facility.h"
+#include "history.h"
+#include "lot_engine.h"
+#include "mapped_file.h"
+
+struct CheckpointHeader {
+    char magic[4];             // "PKCP"
+    uint32_t version;
+    uint64_t logRecords;       // event log records the checkpoint includes
+    int64_t clockNs;           // steadyNs() of the facility clock at the cut
+    int64_t wallNs;            // the same instant, wall clock
+    uint32_t levels;
+    uint32_t handles;          // entries in the handle -> type table
+    uint32_t hasHistory;
+    uint32_t pad;
+};
+
+struct CheckpointLevel {
+    uint64_t slots;
+    int64_t epochNs;           // what startSec/startSub count from, as clockNs
+    double collected;
+};
+
+struct CheckpointHistory {
+    int64_t origin;
+    uint64_t events;
+    int32_t occupancy[HIST_TYPES];
+    uint64_t first[3];         // per resolution, the oldest bucket kept
+    uint64_t buckets[3];       // and how many follow it
+    uint32_t started;
+    uint32_t pad;
+};
+
+const uint32_t CHECKPOINT_VERSION = 2;
+
+// ----------------- CheckpointWriter -----------------
+class CheckpointWriter {
+public:
+    // log, if given, is synced before each checkpoint replaces the last, so
+    // a checkpoint never runs ahead of the log on disk.
+    explicit CheckpointWriter(const std::string &file, EventLog *log = nullptr)
+        : path(file), eventLog(log), worker([this] { run(); }) {}
+    ~CheckpointWriter() {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Any thread. A checkpoint still waiting to be written is replaced.
+    void submit(FacilityCheckpoint &&c) {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            pending = std::move(c);
+            hasPending = true;
+            ++submitted;
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until everything submitted so far is written (or failed).
+    void flush() {
+        std::unique_lock<std::mutex> lk(mu);
+        uint64_t target = submitted;
+        done.wait(lk, [&] { return finished >= target; });
+    }
+
+    uint64_t written() const { std::lock_guard<std::mutex> lk(mu); return writtenCount; }
+    size_t lastBytes() const { std::lock_guard<std::mutex> lk(mu); return lastSize; }
+    double lastWriteMs() const { std::lock_guard<std::mutex> lk(mu); return lastMs; }
+
+    // Appends the file image of c to out.
+    static void serialize(const FacilityCheckpoint &c, std::vector<uint8_t> &out) {
+        const FacilitySnapshot &f = *c.state;
+        CheckpointHeader h = {};
+        memcpy(h.magic, "PKCP", 4);
+        h.version = CHECKPOINT_VERSION;
+        h.logRecords = c.logRecords;
+        h.clockNs = steadyNs(c.at);
+        h.wallNs = c.wallNs;
+        h.levels = (uint32_t)f.levelCount();
+        h.handles = f.levelCount() ? (uint32_t)f.level(0).vehicles().size() : 0;
+        h.hasHistory = c.hasHistory;
+        put(out, &h, sizeof h);
+        for (uint32_t v = 0; v < h.handles; ++v) out.push_back((uint8_t)f.level(0).vehicles()[(VehicleHandle)v].type);
+        pad(out);
+
+        for (size_t l = 0; l < f.levelCount(); ++l) {
+            const LotSnapshot &s = f.level(l);
+            CheckpointLevel lv = { s.size(), s.epochNs, s.collected() };
+            put(out, &lv, sizeof lv);
+            put(out, s.flags.data(), s.size());
+            put(out, s.vehicle.data(), s.size() * sizeof(VehicleHandle));
+            put(out, s.startSec.data(), s.size() * sizeof(int32_t));
+            put(out, s.startSub.data(), s.size() * sizeof(int32_t));
+        }
+
+        if (c.hasHistory) {
+            const HistoryCheckpoint &hc = c.history;
+            CheckpointHistory hh = {};
+            hh.origin = hc.origin;
+            hh.events = hc.events;
+            for (int t = 0; t < HIST_TYPES; ++t) hh.occupancy[t] = hc.occupancy[t];
+            for (int res = 0; res < 3; ++res) {
+                hh.first[res] = hc.rollup[res].first;
+                hh.buckets[res] = hc.rollup[res].end - hc.rollup[res].first;
+            }
+            hh.started = hc.started;
+            put(out, &hh, sizeof hh);
+            for (int res = 0; res < 3; ++res) {
+                const HistoryRollup &r = hc.rollup[res];
+                for (size_t k = 0; k < r.blocks.size(); ++k) {
+                    uint64_t n = std::min<uint64_t>(HistoryRollup::BLOCK, r.end - r.first - k * HistoryRollup::BLOCK);
+                    put(out, r.blocks[k]->b, (size_t)n * sizeof(HistoryBucket));
+                }
+            }
+        }
+        uint32_t crc = crc32(out.data(), out.size());
+        put(out, &crc, sizeof crc);
+    }
+
+private:
+    std::string path;
+    EventLog *eventLog;
+    mutable std::mutex mu;
+    std::condition_variable wake, done;
+    FacilityCheckpoint pending;
+    bool hasPending = false, stopping = false;
+    uint64_t submitted = 0, finished = 0, writtenCount = 0;
+    size_t lastSize = 0;
+    double lastMs = 0.0;
+    std::vector<uint8_t> image;      // reused between writes
+    std::thread worker;              // last: starts once the rest is set up
+
+    // Appends n bytes, padded to a multiple of 8.
+    static void put(std::vector<uint8_t> &out, const void *p, size_t n) {
+        const uint8_t *b = (const uint8_t *)p;
+        out.insert(out.end(), b, b + n);
+        pad(out);
+    }
+    static void pad(std::vector<uint8_t> &out) { out.resize((out.size() + 7) & ~(size_t)7, 0); }
+
+    void run() {
+        std::unique_lock<std::mutex> lk(mu);
+        for (;;) {
+            wake.wait(lk, [this] { return stopping || hasPending; });
+            if (!hasPending) return;
+            FacilityCheckpoint c = std::move(pending);
+            hasPending = false;
+            uint64_t batchEnd = submitted;
+            lk.unlock();
+
+            auto t0 = std::chrono::steady_clock::now();
+            image.clear();
+            serialize(c, image);
+            bool ok = writeFile();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+            lk.lock();
+            if (ok) { ++writtenCount; lastSize = image.size(); lastMs = ms; }
+            finished = batchEnd;
+            done.notify_all();
+        }
+    }
+
+    // The temp file is on disk before it replaces the last checkpoint, and
+    // the rename is on disk before the next one starts.
+    bool writeFile() {
+        std::string tmp = path + ".tmp";
+        std::error_code ec;
+        FILE *out = fopen(tmp.c_str(), "wb");
+        if (!out) return false;
+        bool ok = fwrite(image.data(), 1, image.size(), out) == image.size() && fflush(out) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(out)) == 0;
+#else
+        ok = ok && fsync(fileno(out)) == 0;
+#endif
+        ok = fclose(out) == 0 && ok;
+        // A log that failed to reach disk must not be covered by a checkpoint.
+        if (!ok || (eventLog && !eventLog->sync())) { std::filesystem::remove(tmp, ec); return false; }
+        std::filesystem::rename(tmp, path, ec);
+        return !ec && syncDir();
+    }
+
+    bool syncDir() const {
+#ifdef _WIN32
+        return true;                     // NTFS journals the rename itself
+#else
+        std::filesystem::path dir = std::filesystem::path(path).parent_path();
+        int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+};
+
+// ----------------- Restore -----------------
+// Loads a checkpoint written for this facility layout into its lots and
+// history. Everything is checked before anything is applied; on false the
+// facility is untouched. covered is how many log records it includes.
+inline bool loadCheckpoint(Facility &facility, const std::string &path, const std::string &logPath, uint64_t &covered) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    const uint8_t *base = file.data();
+    size_t size = file.size();
+    uint32_t crc;
+    if (size < sizeof(CheckpointHeader) + 8 || size % 8) return false;
+    size -= 8;                                  // the CRC, padded
+    memcpy(&crc, base + size, sizeof crc);
+    if (crc != crc32(base, size)) return false;
+
+    size_t at = 0;
+    auto take = [&](size_t n) -> const uint8_t * {
+        if (at > size || n > size - at) return nullptr;
+        const uint8_t *p = base + at;
+        at += (n + 7) & ~(size_t)7;
+        return p;
+    };
+    CheckpointHeader h;
+    memcpy(&h, take(sizeof h), sizeof h);
+    if (memcmp(h.magic, "PKCP", 4) != 0 || h.version != CHECKPOINT_VERSION || h.levels != facility.levelCount())
+        return false;
+
+    // The log must still hold everything the checkpoint covers.
+    std::error_code ec;
+    uint64_t logBytes = logPath.empty() ? 0 : std::filesystem::file_size(logPath, ec);
+    if (ec) logBytes = 0;
+    if (h.logRecords && logBytes < EventLog::HEADER_SIZE + h.logRecords * sizeof(LogRecord)) return false;
+
+    // Saved handles to this facility's; every saved type must be registered.
+    const uint8_t *types = take(h.handles);
+    if (!types || h.handles > 256) return false;
+    VehicleHandle remap[256] = {};
+    bool identity = true;
+    for (uint32_t v = 1; v < h.handles; ++v) {
+        remap[v] = facility.withLevel(0, [&](ParkingLot &lot) { return lot.vehicles().find((Vehicle::Type)types[v]); });
+        if (remap[v] == NO_VEHICLE) return false;
+        identity &= remap[v] == v;
+    }
+
+    struct Level {
+        CheckpointLevel info;
+        const uint8_t *flags;
+        const VehicleHandle *vehicle;
+        const int32_t *startSec, *startSub;
+    };
+    std::vector<Level> levels(h.levels);
+    for (uint32_t l = 0; l < h.levels; ++l) {
+        Level &lv = levels[l];
+        const uint8_t *info = take(sizeof(CheckpointLevel));
+        if (!info) return false;
+        memcpy(&lv.info, info, sizeof lv.info);
+        size_t n = (size_t)lv.info.slots;
+        if (n != facility.withLevel(l, [](ParkingLot &lot) { return lot.size(); })) return false;
+        lv.flags = take(n);
+        lv.vehicle = take(n * sizeof(VehicleHandle));
+        lv.startSec = (const int32_t *)take(n * sizeof(int32_t));
+        lv.startSub = (const int32_t *)take(n * sizeof(int32_t));
+        if (!lv.flags || !lv.vehicle || !lv.startSec || !lv.startSub) return false;
+        for (size_t i = 0; i < n; ++i)
+            if (lv.vehicle[i] >= h.handles) return false;
+    }
+
+    HistoryStore *history = facility.historyStore();
+    HistoryCheckpoint hc;
+    if (h.hasHistory) {
+        CheckpointHistory hh;
+        const uint8_t *p = take(sizeof hh);
+        if (!p) return false;
+        memcpy(&hh, p, sizeof hh);
+        hc.started = hh.started != 0;
+        hc.origin = hh.origin;
+        hc.events = hh.events;
+        for (int t = 0; t < HIST_TYPES; ++t) hc.occupancy[t] = hh.occupancy[t];
+        for (int res = 0; res < 3; ++res) {
+            const uint8_t *b = hh.buckets[res] <= size ? take((size_t)hh.buckets[res] * sizeof(HistoryBucket)) : nullptr;
+            if (!b || hh.first[res] % HistoryRollup::BLOCK) return false;
+            if (!history) continue;
+            HistoryRollup &r = hc.rollup[res];
+            r.first = hh.first[res];
+            r.end = r.first + hh.buckets[res];
+            for (uint64_t k = 0; k < hh.buckets[res]; k += HistoryRollup::BLOCK) {
+                r.blocks.push_back(std::make_shared<HistoryRollup::Block>());
+                memcpy(r.blocks.back()->b, b + k * sizeof(HistoryBucket),
+                       (size_t)std::min<uint64_t>(HistoryRollup::BLOCK, hh.buckets[res] - k) * sizeof(HistoryBucket));
+            }
+        }
+    }
+
+    // Start times move with the gap between the cut and now, as the log
+    // restore does: a vehicle parked for ten minutes when the checkpoint
+    // was taken has been parked ten minutes plus the downtime.
+    const Clock &clock = facility.clock();
+    Clock::TimePoint now = clock.now();
+    int64_t shift = steadyNs(now) - std::max<int64_t>(0, clock.wallNs(now) - h.wallNs) - h.clockNs;
+    std::vector<VehicleHandle> mapped;
+    for (uint32_t l = 0; l < h.levels; ++l) {
+        const Level &lv = levels[l];
+        const VehicleHandle *vehicle = lv.vehicle;
+        if (!identity) {
+            mapped.resize((size_t)lv.info.slots);
+            for (size_t i = 0; i < mapped.size(); ++i) mapped[i] = remap[lv.vehicle[i]];
+            vehicle = mapped.data();
+        }
+        facility.withLevel(l, [&](ParkingLot &lot) {
+            lot.restoreColumns(lv.flags, vehicle, lv.startSec, lv.startSub, lv.info.epochNs + shift, lv.info.collected);
+        });
+    }
+    if (h.hasHistory && history) history->restore(hc);
+    covered = h.logRecords;
+    return true;
+}
+
+// Restores the facility from the checkpoint at `path` plus the log records
+// after it, or from the whole log when there is no usable checkpoint. One
+// that exists but cannot be used (another layout, ahead of the log) is
+// deleted, so it cannot come back into use once the log grows past it.
+// Returns the intact length of the log, for EventLog::open.
+inline size_t restoreFacility(Facility &facility, const std::string &path, const std::string &logPath) {
+    uint64_t covered = 0;
+    if (loadCheckpoint(facility, path, logPath, covered)) return facility.replayLog(logPath, covered);
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec)) std::filesystem::remove(path, ec);
+    return facility.replayLog(logPath);
+}
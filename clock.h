@@ -0,0 +1,108 @@
+// Where the lot gets the time from.
+//
+// Callers sample now() once per tick or frame and pass that instant down, so
+// every bill, timer label and deadline in one pass agrees on the time. Clock
+// time is a steady_clock::time_point either way; a VirtualClock just moves it
+// at a multiple of real time, so a day of traffic can be replayed in minutes.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Nanoseconds since the system_clock epoch, right now.
+inline int64_t wallClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+class Clock {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    typedef std::chrono::steady_clock::duration Duration;
+
+    virtual ~Clock() {}
+    virtual TimePoint now() const = 0;
+
+    // Clock seconds per real second; 0 while paused.
+    virtual double rate() const = 0;
+
+    // Real time until the clock reaches t; Duration::max() if it never will.
+    virtual Duration realUntil(TimePoint t) const = 0;
+
+    // Wall-clock ns (system_clock epoch) matching clock time t, for records
+    // that have to survive a restart.
+    virtual int64_t wallNs(TimePoint t) const = 0;
+};
+
+class SystemClock: public Clock {
+public:
+    TimePoint now() const override { return std::chrono::steady_clock::now(); }
+    double rate() const override { return 1.0; }
+    Duration realUntil(TimePoint t) const override { return t - now(); }
+    int64_t wallNs(TimePoint t) const override {
+        return wallClockNs() - std::chrono::duration_cast<std::chrono::nanoseconds>(now() - t).count();
+    }
+};
+
+inline const Clock &systemClock() {
+    static const SystemClock c;
+    return c;
+}
+
+// Starts at the real time it was created and runs `rate` times as fast.
+// Thread-safe; the rate can be changed (or set to 0 to pause) while running.
+class VirtualClock: public Clock {
+public:
+    explicit VirtualClock(double rate = 1.0)
+        : realBase(std::chrono::steady_clock::now()), base(realBase), startTime(realBase), wallBase(wallClockNs()), speed(rate) {}
+
+    TimePoint now() const override {
+        std::lock_guard<std::mutex> lk(mu);
+        return at(std::chrono::steady_clock::now());
+    }
+
+    double rate() const override {
+        std::lock_guard<std::mutex> lk(mu);
+        return speed;
+    }
+
+    Duration realUntil(TimePoint t) const override {
+        std::lock_guard<std::mutex> lk(mu);
+        auto real = std::chrono::steady_clock::now();
+        auto left = t - at(real);
+        if (left <= Duration::zero()) return Duration::zero();
+        if (speed <= 0.0) return Duration::max();
+        return std::chrono::duration_cast<Duration>(std::chrono::duration<double>(left) / speed);
+    }
+
+    int64_t wallNs(TimePoint t) const override {
+        std::lock_guard<std::mutex> lk(mu);
+        return wallBase + std::chrono::duration_cast<std::chrono::nanoseconds>(t - startTime).count();
+    }
+
+    void setRate(double rate) {
+        std::lock_guard<std::mutex> lk(mu);
+        auto real = std::chrono::steady_clock::now();
+        base = at(real);
+        realBase = real;
+        speed = rate;
+    }
+
+    // Jumps forward, e.g. to step a paused clock in tests.
+    void advance(Duration d) {
+        std::lock_guard<std::mutex> lk(mu);
+        base += d;
+    }
+
+private:
+    mutable std::mutex mu;
+    TimePoint realBase;     // real time when the current rate took effect
+    TimePoint base;         // clock time at realBase
+    TimePoint startTime;
+    int64_t wallBase;       // wall ns at startTime
+    double speed;
+
+    TimePoint at(TimePoint real) const {
+        return base + std::chrono::duration_cast<Duration>(std::chrono::duration<double>(real - realBase) * speed);
+    }
+};
@@ -0,0 +1,101 @@
+// Per-slot deadlines (overstay, reservation expiry, tariff steps) kept in a
+// min-heap, so a tick only pays for deadlines that have actually passed.
+// Cancelling bumps a generation counter; stale heap entries are dropped when
+// they surface, and the heap is compacted if they start to pile up.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+enum DeadlineKind { DEADLINE_OVERSTAY = 0, DEADLINE_RESERVATION_EXPIRY, DEADLINE_TARIFF_STEP, DEADLINE_KIND_COUNT };
+
+class DeadlineQueue {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    void reset(size_t slotCount) {
+        heap.clear();
+        gens.assign(slotCount * DEADLINE_KIND_COUNT, 0);
+        armed.assign(slotCount * DEADLINE_KIND_COUNT, 0);
+        live = 0;
+    }
+
+    // Replaces any pending deadline of the same kind for this slot.
+    void schedule(int slot, DeadlineKind kind, TimePoint when) {
+        size_t k = key(slot, kind);
+        if (armed[k]) --live;
+        armed[k] = 1;
+        ++live;
+        heap.push_back({ when, slot, (uint8_t)kind, ++gens[k] });
+        std::push_heap(heap.begin(), heap.end(), Later());
+        if (heap.size() > 64 && heap.size() > 2 * live) compact();
+    }
+
+    void cancel(int slot, DeadlineKind kind) {
+        size_t k = key(slot, kind);
+        if (!armed[k]) return;
+        armed[k] = 0;
+        ++gens[k];
+        --live;
+    }
+
+    void cancelAll(int slot) {
+        for (int kind = 0; kind < DEADLINE_KIND_COUNT; ++kind) cancel(slot, (DeadlineKind)kind);
+    }
+
+    size_t pending() const { return live; }
+
+    // Earliest queued deadline. May belong to a cancelled entry, so it is a
+    // lower bound that is good for deciding how long a caller may sleep.
+    bool nextDue(TimePoint &when) const {
+        if (heap.empty()) return false;
+        when = heap.front().when;
+        return true;
+    }
+
+    // Calls fn(slot, kind) for every live deadline strictly before now.
+    template <class F>
+    int popExpired(TimePoint now, F fn) {
+        int fired = 0;
+        while (!heap.empty() && heap.front().when < now) {
+            Entry e = heap.front();
+            std::pop_heap(heap.begin(), heap.end(), Later());
+            heap.pop_back();
+            size_t k = key(e.slot, (DeadlineKind)e.kind);
+            if (e.gen != gens[k] || !armed[k]) continue;
+            armed[k] = 0;
+            --live;
+            fn(e.slot, (DeadlineKind)e.kind);
+            ++fired;
+        }
+        return fired;
+    }
+
+private:
+    struct Entry {
+        TimePoint when;
+        int slot;
+        uint8_t kind;
+        uint32_t gen;
+    };
+    struct Later {
+        bool operator()(const Entry &a, const Entry &b) const { return a.when > b.when; }
+    };
+
+    std::vector<Entry> heap;
+    std::vector<uint32_t> gens;
+    std::vector<uint8_t> armed;
+    size_t live = 0;
+
+    size_t key(int slot, DeadlineKind kind) const { return (size_t)slot * DEADLINE_KIND_COUNT + kind; }
+
+    void compact() {
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Entry &e) {
+            size_t k = key(e.slot, (DeadlineKind)e.kind);
+            return e.gen != gens[k] || !armed[k];
+        }), heap.end());
+        std::make_heap(heap.begin(), heap.end(), Later());
+    }
+};
@@ -0,0 +1,247 @@
+// Append-only binary log of park/remove events with group commit.
+//
+// append() only copies the record into a pending buffer; a writer thread
+// swaps that buffer out, writes it and fsyncs, so every record queued while
+// the previous fsync was running shares the next one. replay() reads the log
+// back, stopping at the first torn or corrupt record; it can start past a
+// prefix already covered by a checkpoint. A failed write, flush or fsync
+// latches an error: nothing after it counts as durable.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "clock.h"
+
+enum LogEventKind : uint8_t { LOG_PARK = 1, LOG_REMOVE = 2 };
+
+struct LogRecord {
+    uint8_t kind;
+    uint8_t vehicleType;
+    uint16_t level;     // facility level; 0 in single-lot logs
+    int32_t slot;
+    int64_t wallNs;     // system_clock, survives restarts unlike steady_clock
+    double bill;        // LOG_REMOVE only
+    uint32_t crc;
+    uint32_t pad;
+};
+static_assert(sizeof(LogRecord) == 32, "LogRecord layout is part of the file format");
+
+inline uint32_t crc32(const void *data, size_t n) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < n; ++i) c = table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+class EventLog {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 8;
+
+    EventLog() {}
+    ~EventLog() { close(); }
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+
+    // Calls fn(record) for each intact record after the first skipRecords,
+    // which are taken on trust. Returns the byte length of the intact prefix
+    // (0 if the file is missing, has a bad header or is shorter than the
+    // skipped part).
+    template <class F>
+    static size_t replay(const std::string &path, F fn, uint64_t skipRecords = 0) {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) return 0;
+        char hdr[HEADER_SIZE];
+        size_t good = 0;
+        size_t skipBytes = (size_t)skipRecords * sizeof(LogRecord);
+        if (fread(hdr, 1, HEADER_SIZE, f) == HEADER_SIZE && headerOk(hdr) && skipTo(f, HEADER_SIZE + skipBytes)) {
+            good = HEADER_SIZE + skipBytes;
+            LogRecord r;
+            while (fread(&r, sizeof r, 1, f) == 1) {
+                if (r.crc != crc32(&r, offsetof(LogRecord, crc))) break;
+                fn(r);
+                good += sizeof r;
+            }
+        }
+        fclose(f);
+        return good;
+    }
+
+    // Opens for appending after cutting off any torn tail found by replay.
+    // A file too short to hold a header is started afresh; one whose header
+    // is not this version's is left alone and the open fails (see error()).
+    bool open(const std::string &path, size_t validBytes) {
+        close();
+        openError.clear();
+        std::error_code ec;
+        uintmax_t size = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+        if (ec) return fail("cannot read the size of " + path);
+        bool fresh = size < HEADER_SIZE;
+        if (!fresh) {
+            char hdr[HEADER_SIZE];
+            FILE *f = fopen(path.c_str(), "rb");
+            bool ok = f && fread(hdr, 1, HEADER_SIZE, f) == HEADER_SIZE && headerOk(hdr);
+            if (f) fclose(f);
+            if (!ok) return fail(path + " is not a version " + std::to_string(VERSION) + " event log");
+            if (validBytes < HEADER_SIZE || validBytes > size) return fail(path + " is shorter than its checkpoint");
+            if (validBytes < size) std::filesystem::resize_file(path, validBytes, ec);
+            if (ec) return fail("cannot cut the torn tail of " + path);
+        } else if (size > 0) {
+            std::filesystem::resize_file(path, 0, ec);
+            if (ec) return fail("cannot reset " + path);
+        }
+        existing = fresh ? 0 : (validBytes - HEADER_SIZE) / sizeof(LogRecord);
+        file = fopen(path.c_str(), "ab");
+        if (!file) return fail("cannot open " + path + " for appending");
+        if (fresh) {
+            char hdr[HEADER_SIZE];
+            writeHeader(hdr);
+            if (fwrite(hdr, 1, HEADER_SIZE, file) != HEADER_SIZE || fflush(file) != 0) {
+                fclose(file);
+                file = nullptr;
+                return fail("cannot write the header of " + path);
+            }
+        }
+        stopping = false;
+        failed = false;
+        writer = std::thread([this] { run(); });
+        return true;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    // Why the last open() failed, or that a write failed since.
+    std::string error() {
+        std::lock_guard<std::mutex> lk(mu);
+        return failed ? "write to the event log failed" : openError;
+    }
+
+    // False once a write, flush or fsync has failed.
+    bool good() {
+        std::lock_guard<std::mutex> lk(mu);
+        return file && !failed;
+    }
+
+    // Records in the file once everything appended so far is written.
+    uint64_t records() {
+        std::lock_guard<std::mutex> lk(mu);
+        return existing + appended;
+    }
+
+    void append(LogRecord r) {
+        r.pad = 0;
+        r.crc = crc32(&r, offsetof(LogRecord, crc));
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            pending.push_back(r);
+            ++appended;
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until everything appended so far is on disk, or a write has
+    // failed; true if it is on disk. The UI never calls this.
+    bool sync() {
+        std::unique_lock<std::mutex> lk(mu);
+        uint64_t target = appended;
+        wake.notify_one();
+        synced.wait(lk, [&] { return durable >= target || failed || !file; });
+        return durable >= target && !failed;
+    }
+
+    void close() {
+        if (!file) return;
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (writer.joinable()) writer.join();
+        fclose(file);
+        file = nullptr;
+        synced.notify_all();
+    }
+
+    uint64_t commits() const { return commitCount; }
+
+private:
+    FILE *file = nullptr;
+    std::thread writer;
+    std::mutex mu;
+    std::condition_variable wake, synced;
+    std::vector<LogRecord> pending, flushing;
+    uint64_t existing = 0;               // records in the file when opened
+    uint64_t appended = 0, durable = 0;
+    std::atomic<uint64_t> commitCount{0};
+    bool stopping = false;
+    bool failed = false;                 // latched by the writer; see run()
+    std::string openError;
+
+    bool fail(const std::string &why) { openError = why; return false; }
+
+    static void writeHeader(char *hdr) { memcpy(hdr, "PKLG", 4); uint32_t v = VERSION; memcpy(hdr + 4, &v, 4); }
+    static bool headerOk(const char *hdr) { uint32_t v; memcpy(&v, hdr + 4, 4); return memcmp(hdr, "PKLG", 4) == 0 && v == VERSION; }
+
+    static bool skipTo(FILE *f, size_t offset) {
+        if (fseek(f, 0, SEEK_END) != 0 || ftell(f) < (long)offset) return false;
+        return fseek(f, (long)offset, SEEK_SET) == 0;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lk(mu);
+        for (;;) {
+            wake.wait(lk, [this] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+            flushing.swap(pending);
+            uint64_t batchEnd = appended;
+            lk.unlock();
+
+            // After a failure nothing more is written: the file may end in
+            // a partial batch, which replay() will stop at.
+            bool ok = !failed && fwrite(flushing.data(), sizeof(LogRecord), flushing.size(), file) == flushing.size() &&
+                      fflush(file) == 0;
+#ifdef _WIN32
+            ok = ok && _commit(_fileno(file)) == 0;
+#else
+            ok = ok && fsync(fileno(file)) == 0;
+#endif
+            flushing.clear();
+
+            lk.lock();
+            if (ok) {
+                durable = batchEnd;
+                ++commitCount;
+            } else {
+                failed = true;
+            }
+            synced.notify_all();
+        }
+    }
+};
@@ -0,0 +1,408 @@
+// A parking facility made of several levels (or zones), each its own shard.
+//
+// Every level is a ParkingLot behind its own mutex, so work on one level
+// never waits on another. Facility-wide passes (deadline ticks, totals,
+// snapshots) fan out over the levels on a work-stealing pool. The layout
+// comes from a plain-text config read at startup, see loadFacilityConfig.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parking_core.h"
+#include "thread_pool.h"
+
+struct EntryConfig { int col, row; };
+struct RowTypesConfig { int firstRow, lastRow; uint8_t types; };
+
+struct LevelConfig {
+    std::string name;
+    int cols = 0, rows = 0;
+    int slotW = 0, slotH = 0, gapX = 0, gapY = 0;
+    std::vector<EntryConfig> entries;         // none: the top-left corner
+    std::vector<RowTypesConfig> rowTypes;     // rows not listed take every type
+
+    LevelConfig() = default;
+    LevelConfig(const std::string &n, int c, int r, int w, int h, int gx, int gy)
+        : name(n), cols(c), rows(r), slotW(w), slotH(h), gapX(gx), gapY(gy) {}
+};
+
+struct FacilityConfig {
+    std::vector<LevelConfig> levels;
+    std::vector<TariffRule> tariffs;          // none: the built-in tariff
+    int utcOffsetMin = localUtcOffsetMin();   // where tariff times of day are
+};
+
+// "car,truck" -> typeBit mask; 0 if any name is unknown.
+inline uint8_t parseVehicleTypes(const std::string &list) {
+    uint8_t mask = 0;
+    std::istringstream in(list);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (name == "car") mask |= typeBit(Vehicle::CAR);
+        else if (name == "bike") mask |= typeBit(Vehicle::BIKE);
+        else if (name == "truck") mask |= typeBit(Vehicle::TRUCK);
+        else return 0;
+    }
+    return mask;
+}
+
+// "07:30" -> minutes past midnight, 0..1440.
+inline bool parseTimeOfDay(const std::string &s, int &minutes) {
+    int h, m;
+    char colon, rest;
+    std::istringstream in(s);
+    if (!(in >> h >> colon >> m) || colon != ':' || (in >> rest) || h < 0 || m < 0 || m > 59 || h * 60 + m > DAY_MINUTES)
+        return false;
+    minutes = h * 60 + m;
+    return true;
+}
+
+// Tk with at most two decimals -> paisa.
+inline bool parseTk(const std::string &s, int32_t &paisa) {
+    char *end = nullptr;
+    double tk = std::strtod(s.c_str(), &end);
+    if (s.empty() || *end || !(tk >= 0.0 && tk < 1e7)) return false;
+    paisa = toPaisa(tk);
+    return true;
+}
+
+// Rest of a tariff line: <level|*> <types|all> <from>-<to> <Tk> [<sec>:<Tk/s>[+<Tk>]]...
+inline bool parseTariff(std::istringstream &ls, const FacilityConfig &cfg, TariffRule &r) {
+    std::string types, hours, base, step;
+    if (!(ls >> r.level >> types >> hours >> base)) return false;
+    if (r.level != "*" && std::none_of(cfg.levels.begin(), cfg.levels.end(), [&](const LevelConfig &l) { return l.name == r.level; }))
+        return false;
+    r.types = types == "all" ? ALL_VEHICLE_TYPES : parseVehicleTypes(types);
+    size_t dash = hours.find('-');
+    if (!r.types || dash == std::string::npos || !parseTimeOfDay(hours.substr(0, dash), r.fromMin) ||
+        !parseTimeOfDay(hours.substr(dash + 1), r.toMin) || !parseTk(base, r.basePaisa))
+        return false;
+    while (ls >> step) {
+        size_t colon = step.find(':'), plus = step.find('+');
+        TariffStep st = { 0, 0, 0 };
+        char *end = nullptr;
+        long from = std::strtol(step.c_str(), &end, 10);
+        if (colon == std::string::npos || end != step.c_str() + colon || from <= 0 || from > 10000000) return false;
+        if (!r.steps.empty() && from <= r.steps.back().fromSec) return false;
+        st.fromSec = (int32_t)from;
+        if (!parseTk(step.substr(colon + 1, plus == std::string::npos ? std::string::npos : plus - colon - 1), st.ratePaisa)) return false;
+        if (plus != std::string::npos && !parseTk(step.substr(plus + 1), st.jumpPaisa)) return false;
+        r.steps.push_back(st);
+    }
+    return true;
+}
+
+// "+06:00" -> 360.
+inline bool parseUtcOffset(const std::string &s, int &minutes) {
+    if (s.size() < 2 || (s[0] != '+' && s[0] != '-') || !parseTimeOfDay(s.substr(1), minutes) || minutes >= DAY_MINUTES)
+        return false;
+    if (s[0] == '-') minutes = -minutes;
+    return true;
+}
+
+// Tariff and utc_offset lines, in a facility config or a file of their own.
+inline bool parseTariffLine(const std::string &word, std::istringstream &ls, FacilityConfig &cfg) {
+    if (word == "utc_offset") {
+        std::string off;
+        return (ls >> off) && parseUtcOffset(off, cfg.utcOffsetMin);
+    }
+    TariffRule r;
+    if (!parseTariff(ls, cfg, r) || cfg.tariffs.size() >= TariffTable::MAX_PLANS - 1) return false;
+    cfg.tariffs.push_back(r);
+    return true;
+}
+
+// One level per line, optionally followed by its entry points, row
+// restrictions and tariffs:
+//
+//   # name  cols rows  slotW slotH gapX gapY
+//   level   L1   3    2     280   280   50   80
+//   # level col row: in grid cells, -1 or cols/rows is just outside the grid
+//   entry   L1   1   -1
+//   # level firstRow lastRow types
+//   accept  L1   0   0   car,bike
+//   # level|* types|all arriving  Tk  [from-second:Tk-per-second[+Tk]]...
+//   tariff  *  all       00:00-00:00  100  30:1
+//   tariff  L1 car,bike  07:00-19:00  100  30:1  3600:2+50
+//   utc_offset +06:00   # for the times above; default is this machine's
+//
+// A tariff charges its flat Tk from arrival, then from each step on its
+// rate per second and, once, the +Tk. The arrival time picks the tariff:
+// later lines win where they overlap, and arrivals no line covers pay the
+// built-in tariff. Level names are unique and gaps are >= 0. Blank lines
+// and lines starting with '#' are ignored.
+// Returns false, with the offending line number in badLine, if the file is
+// unreadable or wrong.
+inline bool loadFacilityConfig(const std::string &path, FacilityConfig &cfg, int &badLine) {
+    std::ifstream in(path);
+    badLine = 0;
+    if (!in) return false;
+    FacilityConfig out;
+    out.utcOffsetMin = cfg.utcOffsetMin;
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        std::istringstream ls(line);
+        std::string word;
+        if (!(ls >> word) || word[0] == '#') continue;
+        if (word == "tariff" || word == "utc_offset") {
+            if (!parseTariffLine(word, ls, out)) { badLine = n; return false; }
+            continue;
+        }
+        if (word == "entry" || word == "accept") {
+            std::string name, types;
+            ls >> name;
+            auto it = std::find_if(out.levels.begin(), out.levels.end(), [&](const LevelConfig &l) { return l.name == name; });
+            EntryConfig e;
+            RowTypesConfig r;
+            bool ok = it != out.levels.end();
+            if (ok && word == "entry") {
+                ok = (bool)(ls >> e.col >> e.row);
+                if (ok) it->entries.push_back(e);
+            } else if (ok) {
+                ok = (ls >> r.firstRow >> r.lastRow >> types) && r.firstRow <= r.lastRow;
+                r.types = ok ? parseVehicleTypes(types) : 0;
+                if (r.types) it->rowTypes.push_back(r);
+                else ok = false;
+            }
+            if (!ok) { badLine = n; return false; }
+            continue;
+        }
+        LevelConfig l;
+        if (word != "level" || !(ls >> l.name >> l.cols >> l.rows >> l.slotW >> l.slotH >> l.gapX >> l.gapY) ||
+            l.cols <= 0 || l.rows <= 0 || l.slotW <= 0 || l.slotH <= 0 || l.gapX < 0 || l.gapY < 0 ||
+            out.levels.size() >= 0xFFFF ||
+            std::any_of(out.levels.begin(), out.levels.end(), [&](const LevelConfig &o) { return o.name == l.name; })) {
+            badLine = n;
+            return false;
+        }
+        out.levels.push_back(l);
+    }
+    if (out.levels.empty()) return false;
+    cfg = out;
+    return true;
+}
+
+// Only tariff and utc_offset lines, replacing cfg's tariffs; levels named
+// must be in cfg already.
+inline bool loadTariffConfig(const std::string &path, FacilityConfig &cfg, int &badLine) {
+    std::ifstream in(path);
+    badLine = 0;
+    if (!in) return false;
+    FacilityConfig out = cfg;
+    out.tariffs.clear();
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        std::istringstream ls(line);
+        std::string word;
+        if (!(ls >> word) || word[0] == '#') continue;
+        if ((word != "tariff" && word != "utc_offset") || !parseTariffLine(word, ls, out)) { badLine = n; return false; }
+    }
+    cfg = out;
+    return true;
+}
+
+struct FacilityTotals {
+    size_t capacity = 0;
+    int parked = 0;
+    double collected = 0.0;
+    double projected = 0.0;    // collected plus what everyone parked would pay now
+};
+
+class Facility {
+public:
+    explicit Facility(unsigned workers = ThreadPool::defaultWorkers()): pool(workers) {}
+
+    // Lays every level out centred in an areaW x areaH region. Not thread-safe;
+    // call before the facility is shared.
+    void build(const FacilityConfig &cfg, int areaW, int areaH) {
+        shards.clear();
+        for (const LevelConfig &l: cfg.levels) {
+            shards.emplace_back(new Shard);
+            shards.back()->name = l.name;
+            ParkingLot &lot = shards.back()->lot;
+            lot.initGrid(l.cols, l.rows, l.slotW, l.slotH, l.gapX, l.gapY, areaW, areaH);
+            lot.setClock(*clockSource);
+            TariffTable tariffs;
+            tariffs.compile(cfg.tariffs, l.name, cfg.utcOffsetMin);
+            lot.setTariffs(tariffs);
+            for (const RowTypesConfig &r: l.rowTypes)
+                for (int row = std::max(0, r.firstRow); row <= std::min(l.rows - 1, r.lastRow); ++row)
+                    for (int c = 0; c < l.cols; ++c) lot.setAccepts(row * l.cols + c, r.types);
+            // Entries sit on cell centres of the grid, extended past its edges.
+            const GridLayout &g = lot.layout().layout();
+            std::vector<EntryPoint> entries;
+            for (const EntryConfig &e: l.entries)
+                entries.push_back({ g.originX + e.col * g.pitchX + g.cellW / 2, g.originY + e.row * g.pitchY + g.cellH / 2 });
+            if (!entries.empty()) lot.setEntries(entries);
+        }
+    }
+
+    // Every level runs on this clock. Set before the facility is shared.
+    void setClock(const Clock &c) {
+        clockSource = &c;
+        for (auto &s: shards) s->lot.setClock(c);
+    }
+    const Clock &clock() const { return *clockSource; }
+
+    size_t levelCount() const { return shards.size(); }
+    bool validLevel(int l) const { return l >= 0 && l < (int)shards.size(); }
+    const std::string &levelName(size_t l) const { return shards[l]->name; }
+
+    size_t capacity() const {
+        size_t n = 0;
+        for (auto &s: shards) n += s->lot.size();
+        return n;
+    }
+
+    // Registers a vehicle class on every level; handles are the same on all.
+    void addVehicle(const Vehicle &v) { for (auto &s: shards) s->lot.vehicles().add(v); }
+
+    // Reads the log once and restores each level from its own records,
+    // starting after the first skipRecords (what a checkpoint already
+    // covers). Returns the intact length of the file.
+    size_t replayLog(const std::string &path, uint64_t skipRecords = 0) {
+        std::vector<LogRecord> records;
+        size_t good = EventLog::replay(path, [&](const LogRecord &r) { records.push_back(r); }, skipRecords);
+        // History first: departures of vehicles parked before the first
+        // record take their dwell from the lots as the checkpoint left them.
+        if (history) history->restore(records, [this](uint16_t level, int32_t slot) -> int64_t {
+            if (!validLevel(level)) return -1;
+            return withLevel(level, [&](ParkingLot &lot) -> int64_t {
+                if (!lot.valid(slot) || !lot.isParked(slot)) return -1;
+                return clock().wallNs(lot.slot(slot).start_time);
+            });
+        });
+        forEachLevel([&](size_t l, ParkingLot &lot) { lot.restore(records, (uint16_t)l); });
+        return good;
+    }
+
+    // Every level appends to `log`, tagged with its level number.
+    void attachLog(EventLog *log) {
+        eventLog = log;
+        for (size_t l = 0; l < shards.size(); ++l) {
+            std::lock_guard<std::mutex> lk(shards[l]->mu);
+            shards[l]->lot.attachLog(log, (uint16_t)l);
+        }
+    }
+
+    // Every level records its parks and removes in `h`. Attach before
+    // replayLog() to have the history rebuilt from the log as well.
+    void attachHistory(HistoryStore *h) {
+        history = h;
+        for (size_t l = 0; l < shards.size(); ++l) {
+            std::lock_guard<std::mutex> lk(shards[l]->mu);
+            shards[l]->lot.attachHistory(h, (uint16_t)l);
+        }
+    }
+
+    HistoryStore *historyStore() const { return history; }
+
+    // Records in the attached log, including ones not yet written. Read it
+    // on the thread that parks and removes and it matches the lots.
+    uint64_t logRecords() const { return eventLog ? eventLog->records() : 0; }
+
+    // ---------------- Per-level operations ----------------
+    // Each locks just the level it touches.
+
+    // slot < 0 takes the free slot nearest to the level's entry point
+    // `entry` that accepts the type. Returns the slot parked in, or -1.
+    int park(int level, int slot, Vehicle::Type type) { return park(level, slot, type, clock().now()); }
+
+    int park(int level, int slot, Vehicle::Type type, Clock::TimePoint now, size_t entry = 0) {
+        if (!validLevel(level)) return -1;
+        Shard &s = *shards[level];
+        std::lock_guard<std::mutex> lk(s.mu);
+        if (slot < 0) slot = s.lot.nearestFree(type, entry);
+        return s.lot.park(slot, s.lot.vehicles().find(type), now) ? slot : -1;
+    }
+
+    double remove(int level, int slot) { return remove(level, slot, clock().now()); }
+
+    // Returns the bill, or a negative value if there was nothing to remove.
+    double remove(int level, int slot, Clock::TimePoint now) {
+        if (!validLevel(level)) return -1.0;
+        Shard &s = *shards[level];
+        std::lock_guard<std::mutex> lk(s.mu);
+        return s.lot.remove(slot, now);
+    }
+
+    // Runs fn(lot) with the level locked and returns what it returns.
+    template <class F>
+    auto withLevel(size_t level, F fn) -> decltype(fn(std::declval<ParkingLot &>())) {
+        Shard &s = *shards[level];
+        std::lock_guard<std::mutex> lk(s.mu);
+        return fn(s.lot);
+    }
+
+    // ---------------- Facility-wide passes ----------------
+    // fn(level, lot) runs once per level, levels in parallel, each locked.
+    template <class F>
+    void forEachLevel(F fn) {
+        pool.parallelFor(shards.size(), [&](size_t l) {
+            std::lock_guard<std::mutex> lk(shards[l]->mu);
+            fn(l, shards[l]->lot);
+        });
+    }
+
+    int update() { return update(clock().now()); }
+
+    // Fires due deadlines on every level; returns how many fired.
+    int update(Clock::TimePoint now) {
+        std::vector<int> fired(shards.size(), 0);
+        forEachLevel([&](size_t l, ParkingLot &lot) { fired[l] = lot.update(now); });
+        int n = 0;
+        for (int f: fired) n += f;
+        return n;
+    }
+
+    FacilityTotals totals(std::chrono::steady_clock::time_point now) {
+        std::vector<FacilityTotals> part(shards.size());
+        forEachLevel([&](size_t l, ParkingLot &lot) {
+            part[l].capacity = lot.size();
+            part[l].parked = lot.parkedCount();
+            part[l].collected = lot.collected();
+            part[l].projected = lot.projectedRevenue(now);
+        });
+        FacilityTotals t;
+        for (auto &p: part) {
+            t.capacity += p.capacity;
+            t.parked += p.parked;
+            t.collected += p.collected;
+            t.projected += p.projected;
+        }
+        return t;
+    }
+
+    // Earliest deadline on any level, as a sleep bound.
+    bool nextDeadline(DeadlineQueue::TimePoint &when) {
+        bool any = false;
+        for (auto &s: shards) {
+            std::lock_guard<std::mutex> lk(s->mu);
+            DeadlineQueue::TimePoint t;
+            if (s->lot.nextDeadline(t) && (!any || t < when)) { when = t; any = true; }
+        }
+        return any;
+    }
+
+private:
+    struct Shard {
+        std::string name;
+        std::mutex mu;
+        ParkingLot lot;
+    };
+    std::vector<std::unique_ptr<Shard>> shards;
+    const Clock *clockSource = &systemClock();
+    HistoryStore *history = nullptr;
+    EventLog *eventLog = nullptr;
+    ThreadPool pool;
+};
@@ -0,0 +1,352 @@
+// Occupancy and revenue history.
+//
+// Every park and remove is appended as one row of a columnar event store
+// (time, level, slot, vehicle type, dwell, bill) and folded into per-minute,
+// per-hour and per-day rollups at the same time, each split by vehicle type.
+// Dashboard queries read the rollups: a range is covered by whole days, then
+// whole hours, then minutes, so a month costs a few hundred bucket reads.
+//
+// Rows live in fixed-size chunks allocated once per CHUNK events and reused
+// as a ring once maxEvents is reached. Minute buckets are kept for two days
+// and hour buckets for 90 days; day buckets for the whole run. Queries
+// reaching further back than a resolution is kept are widened to whole
+// buckets of the next one. All times are wall-clock ns (system_clock
+// epoch), so buckets line up with UTC minutes, hours and days and history
+// restored from the event log lines up with new events.
+//
+// A checkpoint carries the rollups but not the rows: after a restart from
+// one, forEachEvent() only sees events from the checkpoint on. Rollups are
+// held in shared blocks of BLOCK buckets, so taking a checkpoint copies
+// pointers, and the store copies a block again only when it next writes to
+// one a checkpoint still holds: in practice, the current minute's, hour's
+// and day's.
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "billing.h"
+#include "event_log.h"
+
+enum HistoryKind : uint8_t { HIST_ARRIVE = 1, HIST_DEPART = 2 };
+enum HistoryResolution { HIST_MINUTE = 0, HIST_HOUR = 1, HIST_DAY = 2 };
+
+const int HIST_TYPES = 4;     // index 0 is all vehicle types, 1-3 Vehicle::Type
+
+struct HistoryEvent {
+    int64_t wallNs;
+    uint16_t level;
+    uint8_t kind;
+    uint8_t type;         // Vehicle::Type
+    int32_t slot;
+    float dwellSec;       // departures only
+    double bill;          // departures only
+};
+
+// One bucket of a rollup, per vehicle type.
+struct HistoryBucket {
+    uint32_t arrivals[HIST_TYPES] = {};
+    uint32_t departures[HIST_TYPES] = {};
+    uint32_t overstays[HIST_TYPES] = {};       // departures that stayed past MAX_SECONDS
+    int32_t peakOccupied[HIST_TYPES] = {};     // highest occupancy at any moment in the bucket
+    double revenue[HIST_TYPES] = {};
+    double dwellSec[HIST_TYPES] = {};          // summed over departures
+};
+static_assert(sizeof(HistoryBucket) == 128, "HistoryBucket layout is part of the checkpoint format");
+
+// Buckets [first, end) of one resolution, numbered from the history's
+// origin. first is a multiple of BLOCK.
+struct HistoryRollup {
+    static constexpr size_t BLOCK = 64;
+    struct Block { HistoryBucket b[BLOCK]; };
+
+    std::vector<std::shared_ptr<Block>> blocks;
+    uint64_t first = 0, end = 0;
+
+    bool holds(uint64_t i) const { return i >= first && i < end; }
+    const HistoryBucket &operator[](uint64_t i) const { return blocks[(size_t)((i - first) / BLOCK)]->b[(i - first) % BLOCK]; }
+};
+
+// Everything but the rows, for checkpoints.
+struct HistoryCheckpoint {
+    bool started = false;
+    int64_t origin = 0;
+    int32_t occupancy[HIST_TYPES] = {};
+    uint64_t events = 0;
+    HistoryRollup rollup[3];
+};
+
+struct HistorySummary {
+    uint64_t arrivals = 0, departures = 0, overstays = 0;
+    int peakOccupied = 0;
+    double revenue = 0.0;
+    double dwellSec = 0.0;
+
+    double averageDwellSec() const { return departures ? dwellSec / departures : 0.0; }
+    double overstayRate() const { return departures ? (double)overstays / departures : 0.0; }
+};
+
+class HistoryStore {
+public:
+    static const size_t CHUNK = 4096;
+    static constexpr int64_t MINUTE_NS = 60LL * 1000000000, HOUR_NS = 60 * MINUTE_NS, DAY_NS = 24 * HOUR_NS;
+    static constexpr uint64_t MINUTES_KEPT = 2 * 24 * 60, HOURS_KEPT = 90 * 24;
+
+    // maxEvents is rounded up to a power-of-two number of chunks.
+    explicit HistoryStore(size_t maxEvents = 1 << 20) {
+        size_t chunks = 1;
+        while (chunks * CHUNK < maxEvents) chunks <<= 1;
+        ring.resize(chunks);
+    }
+
+    HistoryStore(const HistoryStore &) = delete;
+    HistoryStore &operator=(const HistoryStore &) = delete;
+
+    // Any thread. Events are expected in roughly time order; one older than
+    // the rollups' start is counted in the first bucket.
+    void append(const HistoryEvent &e) {
+        std::lock_guard<std::mutex> lk(mu);
+        add(e);
+    }
+
+    // Rebuilds history from an event log: every park an arrival, every
+    // remove a departure with the dwell since its park. Call on an empty
+    // store, or one just restored from a checkpoint, before events are
+    // appended. parkedBefore(level, slot) gives the wall ns a vehicle parked
+    // before the first record arrived at, or -1; without it those leave
+    // with no dwell.
+    void restore(const std::vector<LogRecord> &records,
+                 std::function<int64_t(uint16_t, int32_t)> parkedBefore = nullptr) {
+        std::lock_guard<std::mutex> lk(mu);
+        std::unordered_map<uint64_t, int64_t> parkedAt;
+        for (const LogRecord &r: records) {
+            uint64_t key = (uint64_t)r.level << 32 | (uint32_t)r.slot;
+            HistoryEvent e = { r.wallNs, r.level, 0, r.vehicleType, r.slot, 0.0f, 0.0 };
+            if (r.kind == LOG_PARK) {
+                e.kind = HIST_ARRIVE;
+                parkedAt[key] = r.wallNs;
+            } else if (r.kind == LOG_REMOVE) {
+                e.kind = HIST_DEPART;
+                e.bill = r.bill;
+                auto it = parkedAt.find(key);
+                if (it != parkedAt.end()) { e.dwellSec = (float)((r.wallNs - it->second) / 1e9); parkedAt.erase(it); }
+                else if (parkedBefore) {
+                    int64_t at = parkedBefore(r.level, r.slot);
+                    if (at >= 0) e.dwellSec = (float)((r.wallNs - at) / 1e9);
+                }
+            } else {
+                continue;
+            }
+            add(e);
+        }
+    }
+
+    // ---------------- Queries ----------------
+    // Ranges are [fromNs, toNs) in wall ns, widened to whole minutes, or
+    // whole hours or days where minutes or hours are no longer kept. type 0
+    // is every vehicle type.
+    HistorySummary summarize(int64_t fromNs, int64_t toNs, int type = 0) const {
+        std::lock_guard<std::mutex> lk(mu);
+        HistorySummary s;
+        if (!started || type < 0 || type >= HIST_TYPES) return s;
+        int64_t t = std::max(floorTo(fromNs, MINUTE_NS), origin);
+        int64_t end = std::min(floorTo(toNs + MINUTE_NS - 1, MINUTE_NS), origin + (int64_t)rollup[HIST_MINUTE].end * MINUTE_NS);
+        while (t < end) {
+            // The finest resolution still holding t, or a coarser bucket
+            // that starts at t and ends by `end`.
+            int res = HIST_MINUTE;
+            while (res < HIST_DAY && !rollup[res].holds((uint64_t)((t - origin) / WIDTH[res]))) ++res;
+            for (int r = HIST_DAY; r > res; --r)
+                if ((t - origin) % WIDTH[r] == 0 && t + WIDTH[r] <= end) { res = r; break; }
+            uint64_t i = (uint64_t)((t - origin) / WIDTH[res]);
+            const HistoryBucket &b = rollup[res][i];
+            s.arrivals += b.arrivals[type];
+            s.departures += b.departures[type];
+            s.overstays += b.overstays[type];
+            s.peakOccupied = std::max(s.peakOccupied, (int)b.peakOccupied[type]);
+            s.revenue += b.revenue[type];
+            s.dwellSec += b.dwellSec[type];
+            t = origin + (int64_t)(i + 1) * WIDTH[res];
+        }
+        return s;
+    }
+
+    // fn(bucketStartNs, bucket) for every kept bucket of res overlapping
+    // [fromNs, toNs), e.g. to chart occupancy per hour.
+    template <class F>
+    void forEachBucket(HistoryResolution res, int64_t fromNs, int64_t toNs, F fn) const {
+        std::lock_guard<std::mutex> lk(mu);
+        if (!started) return;
+        const HistoryRollup &r = rollup[res];
+        int64_t w = WIDTH[res];
+        int64_t first = std::max<int64_t>((int64_t)r.first, (fromNs - origin) / w);
+        int64_t last = std::min<int64_t>((int64_t)r.end, (toNs - origin + w - 1) / w);
+        for (int64_t i = first; i < last; ++i) fn(origin + i * w, r[(uint64_t)i]);
+    }
+
+    // fn(const HistoryEvent &) for the retained events in [fromNs, toNs),
+    // oldest first.
+    template <class F>
+    void forEachEvent(int64_t fromNs, int64_t toNs, F fn) const {
+        std::lock_guard<std::mutex> lk(mu);
+        uint64_t lo = oldest(), hi = appended;
+        uint64_t a = lo, b = hi;
+        while (a < b) {                       // first event at or after fromNs
+            uint64_t m = a + (b - a) / 2;
+            if (at(m).wallNs < fromNs) a = m + 1; else b = m;
+        }
+        for (uint64_t i = a; i < hi; ++i) {
+            HistoryEvent e = at(i);
+            if (e.wallNs >= toNs) break;
+            fn(e);
+        }
+    }
+
+    HistoryCheckpoint checkpoint() const {
+        std::lock_guard<std::mutex> lk(mu);
+        HistoryCheckpoint c;
+        c.started = started;
+        c.origin = origin;
+        for (int t = 0; t < HIST_TYPES; ++t) c.occupancy[t] = occupancy[t];
+        c.events = carried + appended;
+        for (int res = 0; res < 3; ++res) c.rollup[res] = rollup[res];
+        return c;
+    }
+
+    // Call on an empty store. Shares c's blocks until they are written to.
+    void restore(const HistoryCheckpoint &c) {
+        std::lock_guard<std::mutex> lk(mu);
+        started = c.started;
+        origin = c.origin;
+        for (int t = 0; t < HIST_TYPES; ++t) occupancy[t] = c.occupancy[t];
+        carried = c.events;
+        for (int res = 0; res < 3; ++res) rollup[res] = c.rollup[res];
+        minuteBegin = INT64_MIN;
+    }
+
+    uint64_t eventCount() const { std::lock_guard<std::mutex> lk(mu); return carried + appended; }
+    uint64_t retainedEvents() const { std::lock_guard<std::mutex> lk(mu); return appended - oldest(); }
+    int occupied(int type = 0) const { std::lock_guard<std::mutex> lk(mu); return occupancy[type]; }
+
+private:
+    static constexpr int64_t WIDTH[3] = { MINUTE_NS, HOUR_NS, DAY_NS };
+    static constexpr uint64_t KEPT[3] = { MINUTES_KEPT, HOURS_KEPT, UINT64_MAX };
+
+    // One column per field, CHUNK rows.
+    struct Chunk {
+        int64_t wallNs[CHUNK];
+        int32_t slot[CHUNK];
+        float dwellSec[CHUNK];
+        double bill[CHUNK];
+        uint16_t level[CHUNK];
+        uint8_t kind[CHUNK];
+        uint8_t type[CHUNK];
+    };
+
+    mutable std::mutex mu;
+    std::vector<std::unique_ptr<Chunk>> ring;
+    uint64_t appended = 0;
+    uint64_t carried = 0;                      // events counted before a checkpoint restore
+    bool started = false;
+    int64_t origin = 0;                        // start of the first day
+    int32_t occupancy[HIST_TYPES] = {};
+    HistoryRollup rollup[3];
+    uint64_t cur[3] = {};                      // buckets of the minute last appended to
+    int64_t minuteBegin = INT64_MIN;
+
+    static int64_t floorTo(int64_t t, int64_t w) {
+        int64_t q = t / w;
+        if (t % w < 0) --q;
+        return q * w;
+    }
+
+    // Makes r reach bucket i, dropping blocks that fall out of the last
+    // `kept`, and returns where i's events go: i, or the oldest kept bucket
+    // for an event older than that. Buckets are created before the event
+    // that needs them is counted, so new ones start at the occupancy that
+    // held until then.
+    uint64_t extend(HistoryRollup &r, uint64_t i, uint64_t kept) {
+        const uint64_t B = HistoryRollup::BLOCK;
+        if (i >= r.end && kept != UINT64_MAX && i - r.end >= kept) {
+            r.blocks.clear();                  // a gap longer than is kept
+            r.first = r.end = (i + 1 - kept) / B * B;
+        }
+        while (r.end <= i) {
+            if ((r.end - r.first) % B == 0) r.blocks.push_back(std::make_shared<HistoryRollup::Block>());
+            HistoryBucket &nb = r.blocks.back()->b[(r.end - r.first) % B];
+            nb = HistoryBucket();
+            for (int ty = 0; ty < HIST_TYPES; ++ty) nb.peakOccupied[ty] = occupancy[ty];
+            ++r.end;
+        }
+        if (kept != UINT64_MAX && r.end - r.first >= kept + B) {
+            size_t drop = (size_t)((r.end - kept - r.first) / B);
+            r.blocks.erase(r.blocks.begin(), r.blocks.begin() + drop);
+            r.first += drop * B;
+        }
+        return std::max(i, r.first);
+    }
+
+    // Bucket i of r, after copying its block if a checkpoint shares it.
+    static HistoryBucket &writable(HistoryRollup &r, uint64_t i) {
+        std::shared_ptr<HistoryRollup::Block> &blk = r.blocks[(size_t)((i - r.first) / HistoryRollup::BLOCK)];
+        if (blk.use_count() > 1) blk = std::make_shared<HistoryRollup::Block>(*blk);
+        return blk->b[(i - r.first) % HistoryRollup::BLOCK];
+    }
+
+    uint64_t oldest() const {
+        uint64_t cap = (uint64_t)ring.size() * CHUNK;
+        if (appended <= cap) return 0;
+        return (appended - 1) / CHUNK * CHUNK + CHUNK - cap;
+    }
+
+    HistoryEvent at(uint64_t i) const {
+        const Chunk &c = *ring[(size_t)(i / CHUNK & (ring.size() - 1))];
+        size_t k = (size_t)(i % CHUNK);
+        return { c.wallNs[k], c.level[k], c.kind[k], c.type[k], c.slot[k], c.dwellSec[k], c.bill[k] };
+    }
+
+    void add(const HistoryEvent &e) {
+        size_t ci = (size_t)(appended / CHUNK & (ring.size() - 1));
+        if (!ring[ci]) ring[ci].reset(new Chunk);
+        Chunk &c = *ring[ci];
+        size_t k = (size_t)(appended % CHUNK);
+        c.wallNs[k] = e.wallNs; c.level[k] = e.level; c.kind[k] = e.kind; c.type[k] = e.type;
+        c.slot[k] = e.slot; c.dwellSec[k] = e.dwellSec; c.bill[k] = e.bill;
+        ++appended;
+
+        if (!started) { origin = floorTo(e.wallNs, DAY_NS); started = true; }
+        int64_t t = std::max(e.wallNs, origin);
+        if (t < minuteBegin || t >= minuteBegin + MINUTE_NS) {
+            for (int res = 0; res < 3; ++res) cur[res] = extend(rollup[res], (uint64_t)((t - origin) / WIDTH[res]), KEPT[res]);
+            minuteBegin = origin + (int64_t)cur[HIST_MINUTE] * MINUTE_NS;
+        }
+        HistoryBucket *b[3] = { &writable(rollup[0], cur[0]), &writable(rollup[1], cur[1]), &writable(rollup[2], cur[2]) };
+
+        // Totals in index 0, the vehicle's own type next to them.
+        int types[2] = { 0, e.type < HIST_TYPES ? e.type : 0 };
+        int n = types[1] ? 2 : 1;
+        bool overstay = e.kind == HIST_DEPART && e.dwellSec > MAX_SECONDS;
+        for (int k = 0; k < n; ++k) {
+            int ty = types[k];
+            if (e.kind == HIST_ARRIVE) ++occupancy[ty];
+            else occupancy[ty] = std::max(0, occupancy[ty] - 1);
+            for (int res = 0; res < 3; ++res) {
+                HistoryBucket &r = *b[res];
+                if (e.kind == HIST_ARRIVE) ++r.arrivals[ty];
+                else {
+                    ++r.departures[ty];
+                    if (overstay) ++r.overstays[ty];
+                    r.revenue[ty] += e.bill;
+                    r.dwellSec[ty] += e.dwellSec;
+                }
+                r.peakOccupied[ty] = std::max(r.peakOccupied[ty], occupancy[ty]);
+            }
+        }
+    }
+};
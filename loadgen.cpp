@@ -0,0 +1,282 @@
+// Headless load generator. Replays an arrival/departure trace against a
+// Facility as fast as it will go and reports throughput, tick latency, peak
+// memory, revenue and what the history store makes of the run.
+//
+//   g++ -O2 -mavx2 -std=c++17 loadgen.cpp -o loadgen -pthread
+//   ./loadgen [options]
+//
+// Trace source (default: a generated 24 h trace)
+//   --hours H --start HOUR --rate ARRIVALS_PER_SEC --mix CAR,BIKE,TRUCK
+//   --dwell MEDIAN_SEC --sigma S --seed N
+//   --trace FILE       replay a saved trace instead
+//   --log FILE         replay a recorded event log instead
+//   --save FILE        write the trace out before replaying it
+// Facility
+//   --levels N --bays PER_LEVEL --tick MS (deadline tick, trace time)
+//   --tariffs FILE     tariff and utc_offset lines (see loadFacilityConfig)
+//   --checkpoint FILE  checkpoint the facility after the replay and time
+//                      restoring a fresh one from it
+// Checks; exit status 2 if one fails
+//   --min-ops N        events per second
+//   --max-tick-us X    p99 tick latency
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "checkpoint.h"
+#include "clock.h"
+#include "facility.h"
+#include "history.h"
+#include "traffic.h"
+
+using namespace std::chrono;
+
+static double peakRssMb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc)) return 0.0;
+    return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0.0;
+#ifdef __APPLE__
+    return ru.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return ru.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+static double percentile(std::vector<uint32_t> &v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+struct ReplayResult {
+    size_t arrivals = 0, departures = 0, turnedAway = 0;
+    int peakOccupied = 0;
+    double seconds = 0.0;
+    std::vector<uint32_t> tickNs;
+    FacilityTotals totals;
+};
+
+// Events are applied at their trace time on a paused VirtualClock that is
+// stepped forward tick by tick, so a day replays in however long the engine
+// needs. An arrival tries its own level first, then the others in order.
+static ReplayResult replay(Facility &facility, VirtualClock &clock, const std::vector<TraceEvent> &events, int64_t tickNs) {
+    ReplayResult r;
+    uint32_t maxId = 0;
+    for (const TraceEvent &e: events) maxId = std::max(maxId, e.vehicle);
+    std::vector<int32_t> slotOf(events.empty() ? 0 : (size_t)maxId + 1, -1);
+    std::vector<uint16_t> levelOf(slotOf.size(), 0);
+
+    int levels = (int)facility.levelCount();
+    Clock::TimePoint origin = clock.now();
+    int64_t clockNs = 0, nextTick = tickNs;
+    int occupied = 0;
+    auto begin = steady_clock::now();
+    for (const TraceEvent &e: events) {
+        while (nextTick <= e.atNs) {
+            clock.advance(nanoseconds(nextTick - clockNs));
+            clockNs = nextTick;
+            auto t0 = steady_clock::now();
+            facility.update(origin + nanoseconds(clockNs));
+            r.tickNs.push_back((uint32_t)std::min<int64_t>(UINT32_MAX, duration_cast<nanoseconds>(steady_clock::now() - t0).count()));
+            nextTick += tickNs;
+        }
+        Clock::TimePoint now = origin + nanoseconds(e.atNs);
+        if (e.kind == TRACE_ARRIVE) {
+            ++r.arrivals;
+            int slot = -1, level = e.level % levels;
+            for (int k = 0; k < levels && slot < 0; ++k) {
+                level = (e.level + k) % levels;
+                slot = facility.park(level, -1, (Vehicle::Type)e.type, now);
+            }
+            if (slot < 0) { ++r.turnedAway; continue; }
+            slotOf[e.vehicle] = slot;
+            levelOf[e.vehicle] = (uint16_t)level;
+            r.peakOccupied = std::max(r.peakOccupied, ++occupied);
+        } else {
+            ++r.departures;
+            if (slotOf[e.vehicle] < 0) continue;
+            facility.remove(levelOf[e.vehicle], slotOf[e.vehicle], now);
+            slotOf[e.vehicle] = -1;
+            --occupied;
+        }
+    }
+    r.seconds = duration<double>(steady_clock::now() - begin).count();
+    clock.advance(nanoseconds(std::max<int64_t>(0, (events.empty() ? 0 : events.back().atNs) - clockNs)));
+    r.totals = facility.totals(clock.now());
+    return r;
+}
+
+static void buildFacility(Facility &facility, const FacilityConfig &cfg, int cols, int rows, const Clock &clock,
+                          HistoryStore &history) {
+    facility.build(cfg, cols * 33, rows * 36);
+    facility.setClock(clock);
+    facility.attachHistory(&history);
+    facility.addVehicle(Vehicle(Vehicle::CAR, 0, 0, 0, "Car"));
+    facility.addVehicle(Vehicle(Vehicle::BIKE, 0, 0, 0, "Bike"));
+    facility.addVehicle(Vehicle(Vehicle::TRUCK, 0, 0, 0, "Truck"));
+}
+
+// Mean time of one summarize() call, in microseconds.
+static double queryMicros(const HistoryStore &h, int64_t from, int64_t to, int type, HistorySummary &out) {
+    const int reps = 1000;
+    auto t0 = steady_clock::now();
+    for (int i = 0; i < reps; ++i) out = h.summarize(from, to, type);
+    return duration<double, std::micro>(steady_clock::now() - t0).count() / reps;
+}
+
+static bool parseMix(const char *s, double mix[3]) {
+    return sscanf(s, "%lf,%lf,%lf", &mix[0], &mix[1], &mix[2]) == 3 && mix[0] >= 0 && mix[1] >= 0 && mix[2] >= 0 &&
+           mix[0] + mix[1] + mix[2] > 0;
+}
+
+int main(int argc, char **argv) {
+    TrafficProfile profile;
+    int levels = 40, bays = 1000;
+    double tickMs = 1000.0, minOps = 0.0, maxTickUs = 0.0;
+    std::string tracePath, logPath, savePath, checkpointPath, tariffsPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char *v = i + 1 < argc ? argv[++i] : "";
+        bool ok = *v != '\0';
+        if (a == "--hours") profile.hours = atof(v);
+        else if (a == "--start") profile.startHour = atof(v);
+        else if (a == "--rate") profile.arrivalsPerSec = atof(v);
+        else if (a == "--mix") ok = parseMix(v, profile.mix);
+        else if (a == "--dwell") profile.dwellMedianSec = atof(v);
+        else if (a == "--sigma") profile.dwellSigma = atof(v);
+        else if (a == "--seed") profile.seed = (uint32_t)strtoul(v, nullptr, 10);
+        else if (a == "--trace") tracePath = v;
+        else if (a == "--log") logPath = v;
+        else if (a == "--save") savePath = v;
+        else if (a == "--levels") levels = atoi(v);
+        else if (a == "--bays") bays = atoi(v);
+        else if (a == "--tick") tickMs = atof(v);
+        else if (a == "--tariffs") tariffsPath = v;
+        else if (a == "--checkpoint") checkpointPath = v;
+        else if (a == "--min-ops") minOps = atof(v);
+        else if (a == "--max-tick-us") maxTickUs = atof(v);
+        else ok = false;
+        if (!ok || levels <= 0 || bays <= 0 || tickMs <= 0 || profile.arrivalsPerSec <= 0 || profile.dwellMedianSec <= 0) {
+            std::cerr << "Bad option " << a << " (see the top of loadgen.cpp)" << std::endl;
+            return 1;
+        }
+    }
+    profile.levels = levels;
+
+    std::vector<TraceEvent> events;
+    std::string source;
+    if (!tracePath.empty()) {
+        int badLine = 0;
+        if (!loadTrace(tracePath, events, badLine)) {
+            std::cerr << "Could not read trace " << tracePath;
+            if (badLine) std::cerr << " (line " << badLine << ")";
+            std::cerr << std::endl;
+            return 1;
+        }
+        source = tracePath;
+    } else if (!logPath.empty()) {
+        events = traceFromLog(logPath);
+        source = logPath;
+    } else {
+        events = generateTrace(profile);
+        source = "generated";
+    }
+    if (!savePath.empty() && !saveTrace(savePath, events)) std::cerr << "Could not write " << savePath << std::endl;
+
+    int cols = std::max(1, (int)std::sqrt((double)bays));
+    int rows = (bays + cols - 1) / cols;
+    FacilityConfig cfg;
+    for (int l = 0; l < levels; ++l) cfg.levels.push_back({ "L" + std::to_string(l + 1), cols, rows, 28, 28, 5, 8 });
+    if (!tariffsPath.empty()) {
+        int badLine = 0;
+        if (!loadTariffConfig(tariffsPath, cfg, badLine)) {
+            std::cerr << "Could not read tariffs " << tariffsPath;
+            if (badLine) std::cerr << " (line " << badLine << ")";
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+    VirtualClock clock(0.0);
+    Facility facility;
+    HistoryStore history;
+    buildFacility(facility, cfg, cols, rows, clock, history);
+
+    ReplayResult r = replay(facility, clock, events, (int64_t)(tickMs * 1e6));
+    double opsPerSec = r.seconds > 0 ? events.size() / r.seconds : 0.0;
+    double traceHours = events.empty() ? 0.0 : events.back().atNs / 3.6e12;
+    size_t ticks = r.tickNs.size();
+    double p50 = percentile(r.tickNs, 0.50) / 1000.0, p99 = percentile(r.tickNs, 0.99) / 1000.0;
+    double tickMax = r.tickNs.empty() ? 0.0 : *std::max_element(r.tickNs.begin(), r.tickNs.end()) / 1000.0;
+
+    printf("trace       %s: %zu events (%zu arrivals, %zu departures) over %.1f h\n", source.c_str(), events.size(),
+           r.arrivals, r.departures, traceHours);
+    printf("facility    %d levels x %d bays, %u pool workers\n", levels, cols * rows, ThreadPool::defaultWorkers());
+    printf("replay      %.3f s, %.0f events/s\n", r.seconds, opsPerSec);
+    printf("tick        %zu ticks, p50 %.1f us, p99 %.1f us, max %.1f us\n", ticks, p50, p99, tickMax);
+    printf("occupancy   peak %d / %zu, now %d, %zu arrivals turned away\n", r.peakOccupied, r.totals.capacity,
+           r.totals.parked, r.turnedAway);
+    printf("revenue     collected %.0f Tk, projected %.0f Tk\n", r.totals.collected, r.totals.projected);
+
+    int64_t endWall = clock.wallNs(clock.now()), startWall = endWall - (events.empty() ? 0 : events.back().atNs);
+    HistorySummary all, hour, byType[HIST_TYPES];
+    double allUs = queryMicros(history, startWall, endWall + 1, 0, all);
+    double hourUs = queryMicros(history, endWall - HistoryStore::HOUR_NS, endWall + 1, 0, hour);
+    for (int t = 1; t < HIST_TYPES; ++t) queryMicros(history, startWall, endWall + 1, t, byType[t]);
+    printf("history     %llu events (%llu kept), whole run: peak %d, avg dwell %.0f s, %.1f%% overstay\n",
+           (unsigned long long)history.eventCount(), (unsigned long long)history.retainedEvents(), all.peakOccupied,
+           all.averageDwellSec(), 100.0 * all.overstayRate());
+    printf("            last hour: peak %d, avg dwell %.0f s, %.1f%% overstay\n", hour.peakOccupied, hour.averageDwellSec(),
+           100.0 * hour.overstayRate());
+    printf("            revenue car %.0f, bike %.0f, truck %.0f Tk; query %.2f us (run), %.2f us (hour)\n",
+           byType[1].revenue, byType[2].revenue, byType[3].revenue, allUs, hourUs);
+    if (!checkpointPath.empty()) {
+        // An engine started and stopped at once takes exactly one checkpoint.
+        CheckpointWriter writer(checkpointPath);
+        {
+            LotEngine engine(facility);
+            engine.setCheckpointHandler([&](FacilityCheckpoint &&c) { writer.submit(std::move(c)); }, hours(24));
+            engine.start();
+            engine.stop();
+        }
+        writer.flush();
+        Facility restored;
+        HistoryStore restoredHistory;
+        buildFacility(restored, cfg, cols, rows, clock, restoredHistory);
+        uint64_t covered = 0;
+        auto t0 = steady_clock::now();
+        bool ok = loadCheckpoint(restored, checkpointPath, "", covered);
+        double restoreMs = duration<double, std::milli>(steady_clock::now() - t0).count();
+        FacilityTotals t = restored.totals(clock.now());
+        if (!ok || writer.written() == 0) printf("checkpoint  could not write or read %s\n", checkpointPath.c_str());
+        else
+            printf("checkpoint  %.0f KB, written in %.2f ms, restored in %.2f ms: %d parked, %.0f Tk collected, %llu history events\n",
+                   writer.lastBytes() / 1024.0, writer.lastWriteMs(), restoreMs, t.parked, t.collected,
+                   (unsigned long long)restoredHistory.eventCount());
+    }
+    printf("memory      peak RSS %.1f MB\n", peakRssMb());
+
+    int status = 0;
+    if (minOps > 0 && opsPerSec < minOps) { printf("FAIL        %.0f events/s is below %.0f\n", opsPerSec, minOps); status = 2; }
+    if (maxTickUs > 0 && p99 > maxTickUs) { printf("FAIL        p99 tick %.1f us is above %.1f\n", p99, maxTickUs); status = 2; }
+    return status;
+}
@@ -0,0 +1,456 @@
+// Runs a Facility on its own thread, fed by any number of gates.
+//
+// Producers (UI clicks, gate controllers, plate readers) submit() commands
+// into a lock-free ring and never wait on the lots. The engine thread drains
+// the ring in batches, applies them, fires deadlines and publishes an
+// immutable FacilitySnapshot; readers grab the latest one and keep using it
+// for as long as they like while the engine moves on.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "facility.h"
+#include "mpsc_queue.h"
+#include "parking_core.h"
+#include "profiler.h"
+
+enum LotCommandKind : uint8_t { CMD_PARK = 1, CMD_REMOVE = 2 };
+
+// Gate 0 is the local UI; it is the only gate that gets completions back.
+const uint16_t UI_GATE = 0;
+
+struct LotCommand {
+    uint8_t kind;
+    uint8_t vehicleType;   // CMD_PARK: Vehicle::Type
+    uint16_t gate;
+    uint16_t level;
+    int32_t slot;          // CMD_PARK: -1 takes the free slot nearest the gate's entry
+};
+
+// Gate g > 0 comes in at the level's entry point g - 1, the UI at entry 0;
+// both wrap around the entries a level has.
+inline size_t entryForGate(uint16_t gate) { return gate == UI_GATE ? 0 : gate - 1u; }
+
+struct LotCompletion {
+    uint8_t kind;
+    bool ok;
+    bool assigned;         // CMD_PARK: the engine picked the slot
+    uint16_t gate;
+    uint16_t level;
+    int32_t slot;
+    double bill;           // CMD_REMOVE only
+};
+
+// ----------------- LotSnapshot -----------------
+// Copy of one level's state columns as of one engine batch. Geometry, the
+// vehicle catalog, the spatial index and the tariffs do not change once the
+// engine runs, so they are shared with the lot rather than copied.
+class LotSnapshot {
+public:
+    uint64_t version = 0;
+    std::vector<uint8_t> flags;
+    std::vector<VehicleHandle> vehicle;
+    std::vector<int32_t> startSec, startSub;
+    std::vector<uint8_t> plan;
+    std::vector<uint64_t> changedAt;   // version that last touched each slot
+    int64_t epochNs = 0;
+    int parked = 0;
+    double collectedTk = 0.0;
+    bool hasDeadline = false;
+    DeadlineQueue::TimePoint deadline;
+
+    size_t size() const { return flags.size(); }
+    bool valid(int i) const { return i >= 0 && i < (int)flags.size(); }
+    bool isParked(size_t i) const { return flags[i] & SlotStore::PARKED; }
+    int parkedCount() const { return parked; }
+    double collected() const { return collectedTk; }
+    int slotAt(int x, int y) const { return spatial->query(x, y); }
+    template <class F>
+    void forEachSlotIn(const Rect &area, F fn) const { spatial->forEachIn(area, fn); }
+    const std::vector<Rect> &slotRects() const { return *rects; }
+    const VehicleCatalog &vehicles() const { return *catalog; }
+    const TariffTable &tariffs() const { return *tariffPlans; }
+
+    Slot slot(size_t i) const {
+        const Rect &r = (*rects)[i];
+        uint8_t f = flags[i];
+        return { r.x, r.y, r.w, r.h, (f & SlotStore::PARKED) != 0, (f & SlotStore::OVERSTAY) != 0,
+                 (*catalog)[vehicle[i]], steadyFromNs(epochNs + (int64_t)startSec[i] * 1000000000 + startSub[i]),
+                 tariffPlans, plan[i] };
+    }
+
+    bool nextDeadline(DeadlineQueue::TimePoint &when) const {
+        if (hasDeadline) when = deadline;
+        return hasDeadline;
+    }
+
+    // Calls fn(i) for every slot that changed after version `since`.
+    template <class F>
+    void forEachChangedSince(uint64_t since, F fn) const {
+        for (size_t i = 0; i < changedAt.size(); ++i) if (changedAt[i] > since) fn((int)i);
+    }
+
+private:
+    friend class LotEngine;
+    const std::vector<Rect> *rects = nullptr;
+    const VehicleCatalog *catalog = nullptr;
+    const SlotSpatialIndex *spatial = nullptr;
+    const TariffTable *tariffPlans = nullptr;
+};
+
+// ----------------- FacilitySnapshot -----------------
+// One LotSnapshot per level. Levels nothing happened to keep the snapshot
+// they already had, so a publish only copies the levels that moved.
+class FacilitySnapshot {
+public:
+    uint64_t version = 0;
+    std::vector<std::shared_ptr<const LotSnapshot>> levels;
+    size_t capacity = 0;
+    int parked = 0;
+    double collectedTk = 0.0;
+
+    size_t levelCount() const { return levels.size(); }
+    const LotSnapshot &level(size_t l) const { return *levels[l]; }
+    int parkedCount() const { return parked; }
+    double collected() const { return collectedTk; }
+};
+
+// ----------------- FacilityCheckpoint -----------------
+// A consistent cut of the facility, taken by the engine between batches:
+// the snapshot, the history rollups and how much of the event log they
+// include. Handed to a writer thread, see checkpoint.h.
+struct FacilityCheckpoint {
+    std::shared_ptr<const FacilitySnapshot> state;
+    uint64_t logRecords = 0;
+    Clock::TimePoint at;           // facility clock time of the cut
+    int64_t wallNs = 0;            // the same instant, wall clock
+    bool hasHistory = false;
+    HistoryCheckpoint history;
+};
+
+// ----------------- LotEngine -----------------
+class LotEngine {
+public:
+    static constexpr size_t BATCH = 1024;
+    static constexpr int PUBLISH_MS = 10;    // at most ~100 snapshots a second
+    static constexpr int IDLE_MS = 50;
+
+    explicit LotEngine(Facility &f, size_t capacity = 1 << 16)
+        : facility(f), commands(capacity), completions(capacity), completionSlots(capacity) {}
+    ~LotEngine() { stop(); }
+    LotEngine(const LotEngine &) = delete;
+    LotEngine &operator=(const LotEngine &) = delete;
+
+    // Every `every` of real time, and once more on stop(), the engine thread
+    // publishes and passes a checkpoint to fn. fn runs on the engine thread,
+    // so it should only queue the checkpoint. Set before start().
+    void setCheckpointHandler(std::function<void(FacilityCheckpoint &&)> fn, std::chrono::milliseconds every) {
+        onCheckpoint = fn;
+        checkpointEvery = every;
+    }
+
+    // Set up the facility (levels, vehicles, log) before start(); from then
+    // on only the engine thread changes it.
+    void start() {
+        if (worker.joinable()) return;
+        size_t n = facility.levelCount();
+        changedAt.assign(n, std::vector<uint64_t>());
+        spares.assign(n, nullptr);
+        levelDirty.assign(n, 1);
+        levelDue.assign(n, DeadlineQueue::TimePoint::max());
+        published.assign(n, nullptr);
+        facility.forEachLevel([&](size_t l, ParkingLot &lot) {
+            changedAt[l].assign(lot.size(), 0);
+            lot.drainChanges([](int) {});
+        });
+        publish();
+        running = true;
+        worker = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!worker.joinable()) return;
+        running = false;
+        wakeEngine();
+        worker.join();
+    }
+
+    // Any thread. Fails when the ring is full, or for a UI_GATE command when
+    // as many UI completions are still unpolled as the completion ring holds,
+    // so the engine always has room for the one it owes. Takes a lock only
+    // to wake an idle engine.
+    bool submit(const LotCommand &c) {
+        bool ui = c.gate == UI_GATE;
+        if (ui && uiPending.fetch_add(1) >= completionSlots) { --uiPending; ++dropped; return false; }
+        if (!commands.push(c)) { if (ui) --uiPending; ++dropped; return false; }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) wakeEngine();
+        return true;
+    }
+
+    // Any thread.
+    std::shared_ptr<const FacilitySnapshot> snapshot() const {
+        std::lock_guard<std::mutex> lk(snapMu);
+        return current;
+    }
+
+    // UI thread only: results of UI_GATE commands, oldest first.
+    bool pollCompletion(LotCompletion &out) {
+        if (!completions.pop(out)) return false;
+        --uiPending;
+        return true;
+    }
+
+    const Clock &clock() const { return facility.clock(); }
+    uint64_t applied() const { return appliedCount; }
+    uint64_t rejected() const { return rejectedCount; }
+    uint64_t droppedCommands() const { return dropped; }
+    uint64_t lostCompletions() const { return lost; }   // 0 unless the reservation above is broken
+
+    // Commands taken off the ring whose effects the current snapshot shows.
+    // Once it reaches the number submitted, snapshot() is up to date; a
+    // scripted driver can wait for that to get reproducible frames.
+    uint64_t settled() const { return settledCount.load(std::memory_order_acquire); }
+
+private:
+    Facility &facility;
+    MpscQueue<LotCommand> commands;
+    MpscQueue<LotCompletion> completions;
+    const size_t completionSlots;
+    std::atomic<size_t> uiPending{0}; // UI_GATE commands submitted, completion not yet polled
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::atomic<bool> sleeping{false};
+    std::mutex wakeMu;
+    std::condition_variable wake;
+
+    mutable std::mutex snapMu;
+    std::shared_ptr<const FacilitySnapshot> current;
+    uint64_t version = 0;
+
+    // Engine thread only, one entry per level.
+    std::vector<std::shared_ptr<const LotSnapshot>> published;
+    std::vector<std::shared_ptr<const LotSnapshot>> spares;
+    std::vector<std::vector<uint64_t>> changedAt;
+    std::vector<uint8_t> levelDirty;
+    std::vector<DeadlineQueue::TimePoint> levelDue;
+
+    std::atomic<uint64_t> appliedCount{0}, rejectedCount{0}, dropped{0}, lost{0};
+    std::atomic<uint64_t> settledCount{0};
+    uint64_t taken = 0;              // engine thread only
+
+    std::function<void(FacilityCheckpoint &&)> onCheckpoint;
+    std::chrono::milliseconds checkpointEvery{0};
+
+    void wakeEngine() {
+        std::lock_guard<std::mutex> lk(wakeMu);
+        wake.notify_one();
+    }
+
+    void apply(const LotCommand &c, Clock::TimePoint now) {
+        LotCompletion done = { c.kind, false, c.slot < 0, c.gate, c.level, c.slot, 0.0 };
+        if (c.kind == CMD_PARK) {
+            done.slot = facility.park(c.level, c.slot, (Vehicle::Type)c.vehicleType, now, entryForGate(c.gate));
+            done.ok = done.slot >= 0;
+            if (!done.ok) done.slot = c.slot;
+        } else if (c.kind == CMD_REMOVE) {
+            done.bill = facility.remove(c.level, c.slot, now);
+            done.ok = done.bill >= 0.0;
+        }
+        if (done.ok) { ++appliedCount; levelDirty[c.level] = 1; } else ++rejectedCount;
+        // Cannot fail: submit() reserved this completion's place.
+        if (c.gate == UI_GATE && !completions.push(done)) ++lost;
+    }
+
+    void checkpoint(Clock::TimePoint tick) {
+        PROFILE_SCOPE("engine.checkpoint");
+        for (uint8_t d: levelDirty) if (d) { publish(); break; }
+        FacilityCheckpoint c;
+        c.state = snapshot();
+        c.logRecords = facility.logRecords();
+        c.at = tick;
+        c.wallNs = facility.clock().wallNs(tick);
+        if (HistoryStore *h = facility.historyStore()) { c.history = h->checkpoint(); c.hasHistory = true; }
+        onCheckpoint(std::move(c));
+    }
+
+    void run() {
+        auto lastPublish = std::chrono::steady_clock::now();
+        auto nextCheckpoint = lastPublish + checkpointEvery;
+        bool unpublished = false;
+        const Clock &clock = facility.clock();
+        PROFILE_THREAD("engine");
+        while (running) {
+            // One clock sample per batch: every command in it and the
+            // deadline pass see the same instant.
+            Clock::TimePoint tick = clock.now();
+            size_t n;
+            {
+                PROFILE_SCOPE("engine.apply");
+                n = commands.drain([&](const LotCommand &c) { apply(c, tick); }, BATCH);
+            }
+            taken += n;
+
+            // One parallel pass fires deadlines and notes which levels now
+            // differ from their published snapshot.
+            {
+                PROFILE_SCOPE("engine.tick");
+                facility.forEachLevel([&](size_t l, ParkingLot &lot) {
+                    lot.update(tick);
+                    DeadlineQueue::TimePoint due = DeadlineQueue::TimePoint::max();
+                    lot.nextDeadline(due);
+                    if (lot.hasChanges() || due != levelDue[l]) levelDirty[l] = 1;
+                    levelDue[l] = due;
+                });
+            }
+            for (uint8_t d: levelDirty) if (d) unpublished = true;
+
+            auto now = std::chrono::steady_clock::now();
+            auto publishAt = lastPublish + std::chrono::milliseconds(PUBLISH_MS);
+            if (unpublished && now >= publishAt) {
+                publish();
+                lastPublish = now;
+                unpublished = false;
+            }
+            if (onCheckpoint && now >= nextCheckpoint) {
+                checkpoint(tick);
+                lastPublish = now;
+                unpublished = false;
+                nextCheckpoint = now + checkpointEvery;
+            }
+            if (!unpublished) settledCount.store(taken, std::memory_order_release);
+            if (n == BATCH) continue;
+
+            // Sleep until a command arrives, a deadline is due or a held-back
+            // snapshot may go out. sleeping is raised before the last look at
+            // the ring, so a producer either sees it or its command is seen.
+            // Deadlines are in clock time; the wait is in real time.
+            auto until = now + std::chrono::milliseconds(IDLE_MS);
+            for (auto due: levelDue) {
+                if (due == DeadlineQueue::TimePoint::max()) continue;
+                auto wait = clock.realUntil(due);
+                if (wait < until - now) until = now + wait + std::chrono::microseconds(50);
+            }
+            if (unpublished && publishAt < until) until = publishAt;
+            if (onCheckpoint && nextCheckpoint < until) until = nextCheckpoint;
+            std::unique_lock<std::mutex> lk(wakeMu);
+            sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (commands.empty() && running) wake.wait_until(lk, until);
+            sleeping = false;
+        }
+        if (onCheckpoint) checkpoint(clock.now());
+        else for (uint8_t d: levelDirty) if (d) { publish(); break; }
+    }
+
+    // Re-snapshots every dirty level in parallel, reusing a snapshot nobody
+    // else holds any more where there is one, and swaps in the new set.
+    void publish() {
+        PROFILE_SCOPE("engine.publish");
+        ++version;
+        facility.forEachLevel([this](size_t l, ParkingLot &lot) {
+            if (!levelDirty[l]) return;
+            levelDirty[l] = 0;
+            std::vector<uint64_t> &stamp = changedAt[l];
+            lot.drainChanges([&](int i) { stamp[i] = version; });
+
+            std::shared_ptr<LotSnapshot> s;
+            if (spares[l] && spares[l].use_count() == 1) s = std::const_pointer_cast<LotSnapshot>(spares[l]);
+            else s = std::make_shared<LotSnapshot>();
+            spares[l] = published[l];
+            const SlotStore &cols = lot.columns();
+            s->version = version;
+            s->flags = cols.flags;
+            s->vehicle = cols.vehicle;
+            s->startSec = cols.startSec;
+            s->startSub = cols.startSub;
+            s->plan = cols.plan;
+            s->changedAt = stamp;
+            s->epochNs = lot.epoch();
+            s->parked = lot.parkedCount();
+            s->collectedTk = lot.collected();
+            s->hasDeadline = lot.nextDeadline(s->deadline);
+            s->rects = &cols.rect;
+            s->catalog = &lot.vehicles();
+            s->spatial = &lot.layout();
+            s->tariffPlans = &lot.tariffs();
+            published[l] = s;
+        });
+
+        std::shared_ptr<FacilitySnapshot> f = std::make_shared<FacilitySnapshot>();
+        f->version = version;
+        f->levels = published;
+        for (auto &l: published) {
+            f->capacity += l->size();
+            f->parked += l->parkedCount();
+            f->collectedTk += l->collected();
+        }
+        std::lock_guard<std::mutex> lk(snapMu);
+        current = f;
+    }
+};
+
+// ----------------- GateSimulator -----------------
+// Stand-in for real entry/exit gates: each thread submits a park or a remove
+// on a random level at random intervals, about ratePerSec commands per
+// second of facility clock time per gate.
+class GateSimulator {
+public:
+    ~GateSimulator() { stop(); }
+
+    void start(LotEngine &engine, int gates, double ratePerSec) {
+        stop();
+        running = true;
+        for (int g = 0; g < gates; ++g)
+            threads.emplace_back([this, &engine, g, ratePerSec] { run(engine, (uint16_t)(g + 1), ratePerSec); });
+    }
+
+    void stop() {
+        running = false;
+        for (auto &t: threads) t.join();
+        threads.clear();
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+
+    void run(LotEngine &engine, uint16_t gate, double ratePerSec) {
+        std::mt19937 rng(gate * 7919u);
+        std::exponential_distribution<double> gap(ratePerSec > 0 ? ratePerSec : 1.0);
+        std::uniform_int_distribution<int> type(Vehicle::CAR, Vehicle::TRUCK);
+        while (running) {
+            double speed = std::max(1e-3, engine.clock().rate());
+            auto until = std::chrono::steady_clock::now() +
+                         std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(gap(rng) / speed));
+            for (auto now = std::chrono::steady_clock::now(); running && now < until; now = std::chrono::steady_clock::now())
+                std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - now, std::chrono::milliseconds(50)));
+            auto facility = engine.snapshot();
+            if (!running || !facility || facility->levelCount() == 0) continue;
+            uint16_t level = (uint16_t)(rng() % facility->levelCount());
+            const LotSnapshot *snap = &facility->level(level);
+            if (snap->size() == 0) continue;
+
+            // Exits get likelier once the lot is over half full, so occupancy
+            // hovers around the middle. A remove picks a random parked slot,
+            // giving up after a few probes.
+            bool leave = snap->parkedCount() * 2 > (int)snap->size() ? rng() % 3 != 0 : rng() % 3 == 0;
+            LotCommand c = { CMD_PARK, (uint8_t)type(rng), gate, level, -1 };
+            for (int probe = 0; leave && probe < 64; ++probe) {
+                int i = (int)(rng() % snap->size());
+                if (snap->isParked(i)) { c.kind = CMD_REMOVE; c.slot = i; break; }
+            }
+            engine.submit(c);
+        }
+    }
+};
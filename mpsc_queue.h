@@ -0,0 +1,83 @@
+// Bounded lock-free multi-producer / single-consumer ring.
+//
+// Each cell carries a sequence number: producers claim a position with one
+// CAS on head and publish the cell by bumping its sequence; the consumer
+// owns tail outright. push() never blocks and fails when the ring is full.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+template <class T>
+class MpscQueue {
+public:
+    // capacity is rounded up to a power of two.
+    explicit MpscQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask = n - 1;
+        cells.reset(new Cell[n]);
+        for (size_t i = 0; i < n; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    bool push(const T &v) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        c->value = v;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    bool pop(T &out) {
+        Cell &c = cells[tail & mask];
+        size_t seq = c.seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(tail + 1) < 0) return false;
+        out = c.value;
+        c.seq.store(tail + mask + 1, std::memory_order_release);
+        ++tail;
+        return true;
+    }
+
+    // Consumer thread only. Pops up to max items into fn, returns how many.
+    template <class F>
+    size_t drain(F fn, size_t max) {
+        size_t n = 0;
+        T v;
+        while (n < max && pop(v)) { fn(v); ++n; }
+        return n;
+    }
+
+    // Approximate; exact only when no producer is mid-push.
+    bool empty() const {
+        const Cell &c = cells[tail & mask];
+        return (intptr_t)c.seq.load(std::memory_order_acquire) - (intptr_t)(tail + 1) < 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) size_t tail = 0;
+};
@@ -0,0 +1,88 @@
+// Word-packed occupancy bitset kept in step with the slots, so "first free",
+// "how many parked" and "walk the occupied ones" never touch the Slot array.
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int lowestBit(uint64_t w) {
+#ifdef _MSC_VER
+    unsigned long i; _BitScanForward64(&i, w); return (int)i;
+#else
+    return __builtin_ctzll(w);
+#endif
+}
+
+class OccupancyIndex {
+public:
+    static const int TYPE_COUNT = 4; // indexed by Vehicle::Type
+
+    OccupancyIndex(): n(0), total(0) { clearCounts(); }
+
+    void reset(size_t slotCount) {
+        n = slotCount;
+        bits.assign((n + 63) / 64, 0);
+        // One summary bit per word: set while that word still has a free bit.
+        notFull.assign((bits.size() + 63) / 64, 0);
+        for (size_t w = 0; w < bits.size(); ++w) notFull[w >> 6] |= 1ull << (w & 63);
+        total = 0;
+        clearCounts();
+    }
+
+    size_t size() const { return n; }
+    int count() const { return total; }
+    int count(int type) const { return (type >= 0 && type < TYPE_COUNT) ? byType[type] : 0; }
+    bool test(size_t i) const { return (bits[i >> 6] >> (i & 63)) & 1; }
+
+    void set(size_t i, int type) {
+        uint64_t &w = bits[i >> 6];
+        w |= 1ull << (i & 63);
+        if (w == ~0ull) notFull[i >> 12] &= ~(1ull << ((i >> 6) & 63));
+        ++total;
+        if (type >= 0 && type < TYPE_COUNT) ++byType[type];
+    }
+
+    void clear(size_t i, int type) {
+        bits[i >> 6] &= ~(1ull << (i & 63));
+        notFull[i >> 12] |= 1ull << ((i >> 6) & 63);
+        --total;
+        if (type >= 0 && type < TYPE_COUNT) --byType[type];
+    }
+
+    // Lowest free slot index, or -1 when the lot is full.
+    int firstFree() const {
+        for (size_t s = 0; s < notFull.size(); ++s) {
+            if (!notFull[s]) continue;
+            size_t w = s * 64 + lowestBit(notFull[s]);
+            size_t i = w * 64 + lowestBit(~bits[w]);
+            // Padding bits past the last slot read as free; anything found
+            // there means every real slot is taken.
+            return i < n ? (int)i : -1;
+        }
+        return -1;
+    }
+
+    template <class F>
+    void forEachOccupied(F fn) const {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            uint64_t b = bits[w];
+            while (b) {
+                fn(w * 64 + lowestBit(b));
+                b &= b - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> bits;
+    std::vector<uint64_t> notFull;
+    size_t n;
+    int total;
+    int byType[TYPE_COUNT];
+
+    void clearCounts() { for (int t = 0; t < TYPE_COUNT; ++t) byType[t] = 0; }
+};
@@ -0,0 +1,136 @@
+// Offscreen GL context for running the renderer without a window.
+//
+// An EGL pbuffer with a desktop GL (compatibility) context, so the GL 1.1
+// client-array path renders exactly as it does on screen. With Mesa it needs
+// no display or GPU: the surfaceless platform plus LIBGL_ALWAYS_SOFTWARE=1
+// renders on llvmpipe, which also makes the pixels the same on every machine.
+// Link with -lEGL -lGL.
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class OffscreenContext {
+public:
+    OffscreenContext() {}
+    ~OffscreenContext() { destroy(); }
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    // Creates a w x h RGBA pbuffer and makes it current on this thread.
+    // On failure returns false and error() says which step failed.
+    bool create(int w, int h) {
+        destroy();
+        display = platformDisplay();
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) return fail("eglInitialize");
+        const EGLint configAttrs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_NONE
+        };
+        EGLConfig config;
+        EGLint found = 0;
+        if (!eglChooseConfig(display, configAttrs, &config, 1, &found) || found < 1) return fail("eglChooseConfig");
+        const EGLint surfaceAttrs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttrs);
+        if (surface == EGL_NO_SURFACE) return fail("eglCreatePbufferSurface");
+        if (!eglBindAPI(EGL_OPENGL_API)) return fail("eglBindAPI");
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+        if (context == EGL_NO_CONTEXT) return fail("eglCreateContext");
+        if (!eglMakeCurrent(display, surface, surface, context)) return fail("eglMakeCurrent");
+        width = w; height = h;
+        return true;
+    }
+
+    void destroy() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY; surface = EGL_NO_SURFACE; context = EGL_NO_CONTEXT;
+    }
+
+    const std::string &error() const { return lastError; }
+    std::string renderer() const {
+        const GLubyte *r = glGetString(GL_RENDERER);
+        return r ? (const char *)r : "";
+    }
+
+    // Reads the frame back as top-down RGB rows.
+    void readPixels(std::vector<uint8_t> &rgb) const {
+        rgb.resize((size_t)width * height * 3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+        size_t row = (size_t)width * 3;
+        std::vector<uint8_t> tmp(row);
+        for (int y = 0; y < height / 2; ++y) {
+            uint8_t *a = &rgb[(size_t)y * row], *b = &rgb[(size_t)(height - 1 - y) * row];
+            std::copy(a, a + row, tmp.begin());
+            std::copy(b, b + row, a);
+            std::copy(tmp.begin(), tmp.end(), b);
+        }
+    }
+
+    int w() const { return width; }
+    int h() const { return height; }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    int width = 0, height = 0;
+    std::string lastError;
+
+    bool fail(const char *step) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "%s failed (0x%x)", step, (unsigned)eglGetError());
+        lastError = buf;
+        destroy();
+        return false;
+    }
+
+    // Mesa's surfaceless platform where there is one, so no X server is
+    // needed; otherwise whatever the default display is.
+    static EGLDisplay platformDisplay() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (d != EGL_NO_DISPLAY) return d;
+        }
+#endif
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+};
+
+// Binary PPM (P6) of top-down RGB rows.
+inline bool writePPM(const std::string &path, int w, int h, const std::vector<uint8_t> &rgb) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    fwrite(rgb.data(), 1, rgb.size(), f);
+    return fclose(f) == 0;
+}
+
+inline bool readPPM(const std::string &path, int &w, int &h, std::vector<uint8_t> &rgb) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    int maxval = 0;
+    bool ok = fscanf(f, "P6 %d %d %d", &w, &h, &maxval) == 3 && maxval == 255 && w > 0 && h > 0 && fgetc(f) != EOF;
+    if (ok) {
+        rgb.resize((size_t)w * h * 3);
+        ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+    }
+    fclose(f);
+    return ok;
+}
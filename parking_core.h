@@ -0,0 +1,452 @@
+// Headless occupancy/billing engine. No GL or GLUT in here so the lot can be
+// driven from tools and benchmarks on machines without a display.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <functional>
+
+#include "billing.h"
+#include "clock.h"
+#include "deadline_queue.h"
+#include "event_log.h"
+#include "history.h"
+#include "occupancy_index.h"
+#include "slot_allocator.h"
+#include "spatial_index.h"
+
+// ----------------- Vehicle -----------------
+class Vehicle {
+public:
+    enum Type { NONE = 0, CAR = 1, BIKE = 2, TRUCK = 3 };
+    Vehicle(): type(NONE), texId(0), texW(0), texH(0), name("None") {}
+    Vehicle(Type t, unsigned int id, int w, int h, const std::string &n)
+        : type(t), texId(id), texW(w), texH(h), name(n) {}
+    Type type;
+    unsigned int texId;
+    int texW, texH;
+    std::string name;
+};
+
+// Which vehicle types a slot takes, one bit per Vehicle::Type.
+inline uint8_t typeBit(Vehicle::Type t) { return (uint8_t)(1u << t); }
+const uint8_t ALL_VEHICLE_TYPES = (1u << Vehicle::CAR) | (1u << Vehicle::BIKE) | (1u << Vehicle::TRUCK);
+
+// Slots refer to vehicles by a one-byte handle into this table. Handle 0 is
+// always the empty Vehicle().
+typedef uint8_t VehicleHandle;
+const VehicleHandle NO_VEHICLE = 0;
+
+class VehicleCatalog {
+public:
+    VehicleCatalog() { entries.push_back(Vehicle()); }
+
+    // Registers a vehicle class, replacing an existing entry of the same type.
+    VehicleHandle add(const Vehicle &v) {
+        VehicleHandle h = find(v.type);
+        if (h != NO_VEHICLE) { entries[h] = v; return h; }
+        entries.push_back(v);
+        return (VehicleHandle)(entries.size() - 1);
+    }
+
+    VehicleHandle find(Vehicle::Type t) const {
+        for (size_t h = 1; h < entries.size(); ++h) if (entries[h].type == t) return (VehicleHandle)h;
+        return NO_VEHICLE;
+    }
+
+    const Vehicle &operator[](VehicleHandle h) const { return h < entries.size() ? entries[h] : entries[0]; }
+    size_t size() const { return entries.size(); }
+
+private:
+    std::vector<Vehicle> entries;
+};
+
+// ----------------- Slot -----------------
+// Read-only snapshot of one slot, assembled from the lot's column arrays.
+class Slot {
+public:
+    int x, y, w, h;
+    bool parked;
+    bool overstay;
+    const Vehicle &vehicle;
+    std::chrono::steady_clock::time_point start_time;
+    const TariffTable *tariffs;
+    uint8_t plan;                          // in tariffs, picked on arrival
+
+    bool contains(int mx, int my) const { return (mx >= x && mx <= x + w && my >= y && my <= y + h); }
+
+    // `now` is the caller's once-per-frame clock sample.
+    double elapsedSeconds(Clock::TimePoint now) const {
+        if (!parked) return 0.0;
+        return std::chrono::duration<double>(now - start_time).count();
+    }
+
+    double computeBill(Clock::TimePoint now) const { return parked ? tariffs->bill(plan, elapsedSeconds(now)) : 0.0; }
+
+    // What the stay costs before any per-second charge.
+    double flatPrice() const { return parked ? tariffs->basePaisa(plan) / 100.0 : 0.0; }
+};
+
+// Slot state as parallel arrays. Per-tick and per-frame passes read only the
+// column they need: one byte of flags per slot instead of a whole Slot.
+struct SlotStore {
+    enum Flags : uint8_t { PARKED = 1, OVERSTAY = 2 };
+
+    std::vector<Rect> rect;
+    std::vector<int32_t> startSec;         // whole seconds since the lot epoch
+    std::vector<int32_t> startSub;         // plus this many ns, 0..1e9-1
+    std::vector<uint8_t> flags;
+    std::vector<VehicleHandle> vehicle;
+    std::vector<uint8_t> accepts;          // typeBit() of every type allowed to park
+    std::vector<uint8_t> plan;             // TariffTable plan of the vehicle parked
+
+    size_t size() const { return flags.size(); }
+
+    void assign(const std::vector<Rect> &rects) {
+        rect = rects;
+        startSec.assign(rects.size(), 0);
+        startSub.assign(rects.size(), 0);
+        flags.assign(rects.size(), 0);
+        vehicle.assign(rects.size(), NO_VEHICLE);
+        accepts.assign(rects.size(), ALL_VEHICLE_TYPES);
+        plan.assign(rects.size(), 0);
+    }
+};
+
+inline int64_t steadyNs(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+inline std::chrono::steady_clock::time_point steadyFromNs(int64_t ns) {
+    return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+// Splits ns since an epoch into floor seconds and a non-negative remainder.
+inline void splitNs(int64_t ns, int32_t &sec, int32_t &sub) {
+    int64_t s = ns / 1000000000, r = ns % 1000000000;
+    if (r < 0) { r += 1000000000; --s; }
+    sec = (int32_t)s; sub = (int32_t)r;
+}
+
+// ----------------- ParkingLot -----------------
+// Owns the slots and the money. Everything the UI can do to the lot goes
+// through park()/remove()/update() so a headless driver sees the same rules.
+// Each of those takes the current time from the caller, who samples the
+// lot's clock once per batch; the overloads without it sample it themselves.
+class ParkingLot {
+public:
+    ParkingLot(): totalCollected(0.0) {}
+
+    // Lays out cols x rows slots centred in an areaW x areaH region.
+    void initGrid(int cols, int rows, int slotW, int slotH, int gapX, int gapY, int areaW, int areaH) {
+        std::vector<Rect> rects;
+        rects.reserve((size_t)cols * rows);
+        int totalW = cols * slotW + (cols - 1) * gapX;
+        int totalH = rows * slotH + (rows - 1) * gapY;
+        int startX = (areaW - totalW) / 2;
+        int startY = (areaH - totalH) / 2;
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                int sx = startX + c * (slotW + gapX);
+                int sy = startY + r * (slotH + gapY);
+                rects.push_back({ sx, sy, slotW, slotH });
+            }
+        }
+        GridLayout g;
+        g.originX = startX; g.originY = startY;
+        g.cellW = slotW; g.cellH = slotH;
+        g.pitchX = slotW + gapX; g.pitchY = slotH + gapY;
+        g.cols = cols; g.rows = rows;
+        spatial.buildGrid(g);
+        resetState(rects);
+    }
+
+    // Arbitrary layout, e.g. a hand-drawn floor plan.
+    void initSlots(const std::vector<Rect> &rects) {
+        spatial.buildRects(rects);
+        resetState(rects);
+    }
+
+    size_t size() const { return store.size(); }
+    bool valid(int i) const { return i >= 0 && i < (int)store.size(); }
+    bool isParked(size_t i) const { return store.flags[i] & SlotStore::PARKED; }
+
+    Slot slot(size_t i) const {
+        const Rect &r = store.rect[i];
+        uint8_t f = store.flags[i];
+        return { r.x, r.y, r.w, r.h, (f & SlotStore::PARKED) != 0, (f & SlotStore::OVERSTAY) != 0,
+                 catalog[store.vehicle[i]], steadyFromNs(startNsOf(i)), &tariffTable, store.plan[i] };
+    }
+
+    // Not thread-safe; set before the lot is shared. The clock must outlive the lot.
+    void setClock(const Clock &c) { clock = &c; }
+    const Clock &timeSource() const { return *clock; }
+
+    const SlotStore &columns() const { return store; }
+    int64_t epoch() const { return epochNs; }        // steady ns that startSec/startSub count from
+    VehicleCatalog &vehicles() { return catalog; }
+    const VehicleCatalog &vehicles() const { return catalog; }
+    int slotAt(int x, int y) const { return spatial.query(x, y); }
+    const SlotSpatialIndex &layout() const { return spatial; }
+
+    bool park(int i, VehicleHandle h) { return park(i, h, clock->now()); }
+
+    bool park(int i, VehicleHandle h, Clock::TimePoint now) {
+        if (!valid(i) || isParked(i) || catalog[h].type == Vehicle::NONE || !(store.accepts[i] & typeBit(catalog[h].type)))
+            return false;
+        int64_t wall = log || history || tariffTable.byTimeOfDay() ? clock->wallNs(now) : 0;
+        placeVehicle(i, h, steadyNs(now), wall);
+        if (!log && !history) return true;
+        uint8_t type = (uint8_t)catalog[h].type;
+        if (log) log->append({ LOG_PARK, type, logLevel, i, wall, 0.0, 0, 0 });
+        if (history) history->append({ wall, historyLevel, HIST_ARRIVE, type, i, 0.0f, 0.0 });
+        return true;
+    }
+
+    double remove(int i) { return remove(i, clock->now()); }
+
+    // Returns the bill, or a negative value if there was nothing to remove.
+    double remove(int i, Clock::TimePoint now) {
+        if (!valid(i) || !isParked(i)) return -1.0;
+        Vehicle::Type type = catalog[store.vehicle[i]].type;
+        double elapsed = (steadyNs(now) - startNsOf(i)) / 1e9;
+        double bill = tariffTable.bill(store.plan[i], elapsed);
+        clearVehicle(i);
+        totalCollected += bill;
+        if (!log && !history) return bill;
+        int64_t wall = clock->wallNs(now);
+        if (log) log->append({ LOG_REMOVE, (uint8_t)type, logLevel, i, wall, bill, 0, 0 });
+        if (history) history->append({ wall, historyLevel, HIST_DEPART, (uint8_t)type, i, (float)elapsed, bill });
+        return bill;
+    }
+
+    // ---------------- Durability ----------------
+    // Every successful park/remove is appended to the attached log, tagged
+    // with `level` so several lots of a facility can share one log.
+    void attachLog(EventLog *l, uint16_t level = 0) { log = l; logLevel = level; }
+
+    // Same for the history store, with its own level tag.
+    void attachHistory(HistoryStore *h, uint16_t level = 0) { history = h; historyLevel = level; }
+
+    // Rebuilds slot state and revenue from a log written by attachLog. Call on
+    // an empty lot, before attaching. Start times are carried over in wall
+    // clock time, so a vehicle parked before a restart keeps its elapsed time.
+    // Returns the length of the intact part of the log.
+    size_t replayLog(const std::string &path, uint16_t level = 0) {
+        std::vector<LogRecord> records;
+        size_t good = EventLog::replay(path, [&](const LogRecord &r) { records.push_back(r); });
+        restore(records, level);
+        return good;
+    }
+
+    // The part of replayLog that applies records, for callers that read the
+    // log once for several lots. Records of other levels are skipped. The
+    // records are applied on top of what the lot holds, so a lot restored
+    // from a checkpoint can take the rest of the log after it.
+    void restore(const std::vector<LogRecord> &records, uint16_t level) {
+        const int64_t UNTOUCHED = -1, REMOVED = -2;
+        std::vector<int64_t> startWall(size(), UNTOUCHED);
+        std::vector<uint8_t> type(size(), 0);
+        double collectedSum = 0.0;
+        for (const LogRecord &r: records) {
+            if (r.level != level || !valid(r.slot)) continue;
+            if (r.kind == LOG_PARK) { startWall[r.slot] = r.wallNs; type[r.slot] = r.vehicleType; }
+            else if (r.kind == LOG_REMOVE) { startWall[r.slot] = REMOVED; collectedSum += r.bill; }
+        }
+
+        Clock::TimePoint now = clock->now();
+        int64_t steadyNow = steadyNs(now);
+        int64_t wallNow = clock->wallNs(now);
+        for (size_t i = 0; i < size(); ++i) {
+            if (startWall[i] == UNTOUCHED) continue;
+            if (isParked(i)) clearVehicle((int)i);      // its bill is in the records
+            if (startWall[i] == REMOVED) continue;
+            VehicleHandle h = catalog.find((Vehicle::Type)type[i]);
+            if (h == NO_VEHICLE) continue;
+            // A log written under a faster clock can run ahead of this one.
+            placeVehicle((int)i, h, steadyNow - std::max<int64_t>(0, wallNow - startWall[i]), startWall[i]);
+        }
+        totalCollected += collectedSum;
+    }
+
+    // Loads the state columns of a checkpoint taken from a lot of the same
+    // size. Start times keep counting from `epoch`, a steady ns value already
+    // shifted to this process. vehicle holds handles of this lot's catalog.
+    // Call on an empty lot, before restore() applies the log after it.
+    void restoreColumns(const uint8_t *flags, const VehicleHandle *vehicle, const int32_t *startSec,
+                        const int32_t *startSub, int64_t epoch, double collected) {
+        size_t n = size();
+        std::copy(flags, flags + n, store.flags.begin());
+        std::copy(vehicle, vehicle + n, store.vehicle.begin());
+        std::copy(startSec, startSec + n, store.startSec.begin());
+        std::copy(startSub, startSub + n, store.startSub.begin());
+        epochNs = epoch;
+        totalCollected = collected;
+        for (size_t i = 0; i < n; ++i) {
+            if (!isParked(i)) continue;
+            occupancy.set(i, catalog[store.vehicle[i]].type);
+            allocator.take((int)i, store.accepts[i]);
+            store.plan[i] = tariffTable.planFor(catalog[store.vehicle[i]].type, clock->wallNs(steadyFromNs(startNsOf(i))));
+            if (!(store.flags[i] & SlotStore::OVERSTAY))
+                deadlines.schedule((int)i, DEADLINE_OVERSTAY, steadyFromNs(startNsOf(i)) + std::chrono::seconds(MAX_SECONDS));
+            markChanged((int)i);
+        }
+    }
+
+    // Fires whatever deadlines have passed; overstay is handled here, other
+    // kinds are handed to the deadline handler if one is installed.
+    int update() { return update(clock->now()); }
+
+    int update(Clock::TimePoint now) {
+        return deadlines.popExpired(now, [this](int i, DeadlineKind kind) {
+            if (kind == DEADLINE_OVERSTAY) { store.flags[i] |= SlotStore::OVERSTAY; markChanged(i); }
+            else if (onDeadline) onDeadline(i, kind);
+        });
+    }
+
+    void scheduleDeadline(int i, DeadlineKind kind, DeadlineQueue::TimePoint when) {
+        if (valid(i)) deadlines.schedule(i, kind, when);
+    }
+    void cancelDeadline(int i, DeadlineKind kind) { if (valid(i)) deadlines.cancel(i, kind); }
+    void setDeadlineHandler(std::function<void(int, DeadlineKind)> fn) { onDeadline = fn; }
+    size_t pendingDeadlines() const { return deadlines.pending(); }
+    bool nextDeadline(DeadlineQueue::TimePoint &when) const { return deadlines.nextDue(when); }
+
+    int parkedCount() const { return occupancy.count(); }
+    int parkedCount(Vehicle::Type t) const { return occupancy.count(t); }
+    int firstFree() const { return occupancy.firstFree(); }
+
+    // ---------------- Assignment ----------------
+    // Entry points are where vehicles come in, in layout coordinates. Until
+    // set, a lot has one at the top-left corner of its slots.
+    void setEntries(const std::vector<EntryPoint> &points) {
+        entryPoints = points;
+        if (entryPoints.empty()) entryPoints.push_back(cornerEntry());
+        allocator.build(store.rect, entryPoints);
+        for (size_t i = 0; i < size(); ++i)
+            if (!isParked(i)) allocator.release((int)i, store.accepts[i]);
+    }
+    const std::vector<EntryPoint> &entries() const { return entryPoints; }
+
+    // Restricts which vehicle types may park in slot i (typeBit() mask).
+    // A vehicle already there stays.
+    void setAccepts(int i, uint8_t mask) {
+        if (!valid(i)) return;
+        if (!isParked(i)) { allocator.take(i, store.accepts[i]); allocator.release(i, mask); }
+        store.accepts[i] = mask;
+    }
+
+    // Free slot nearest to entry point `entry` that takes this type, or -1.
+    int nearestFree(Vehicle::Type t, size_t entry = 0) const { return allocator.nearest(t, entry); }
+    const OccupancyIndex &index() const { return occupancy; }
+
+    double collected() const { return totalCollected; }
+
+    // ---------------- Tariffs ----------------
+    // A vehicle is billed on the plan for its type and arrival time. New
+    // tariffs re-pick the plan of every vehicle already parked.
+    void setTariffs(const TariffTable &t) {
+        tariffTable = t;
+        for (size_t i = 0; i < size(); ++i)
+            if (isParked(i))
+                store.plan[i] = tariffTable.planFor(catalog[store.vehicle[i]].type, clock->wallNs(steadyFromNs(startNsOf(i))));
+    }
+    const TariffTable &tariffs() const { return tariffTable; }
+
+    // Bills every occupied slot as of one instant in a single pass over the
+    // start-time columns. bills (optional, size() entries) gets paisa per slot.
+    BillTotals billAll(std::chrono::steady_clock::time_point now, int32_t *bills = nullptr) const {
+        int32_t nowSec, nowSub;
+        splitNs(steadyNs(now) - epochNs, nowSec, nowSub);
+        return tariffTable.billAll(store.startSec.data(), store.startSub.data(), store.flags.data(), store.plan.data(),
+                                   store.size(), SlotStore::PARKED, nowSec, nowSub, bills);
+    }
+
+    // What the lot would have collected if every vehicle left at `now`.
+    double projectedRevenue(std::chrono::steady_clock::time_point now) const {
+        return totalCollected + billAll(now).totalTk();
+    }
+
+    bool hasChanges() const { return !changed.empty(); }
+
+    // Hands out each slot whose parked/vehicle/overstay state changed since
+    // the previous call, once, so views can patch only what moved.
+    template <class F>
+    void drainChanges(F fn) {
+        for (int i: changed) { changedMark[i] = 0; fn(i); }
+        changed.clear();
+    }
+
+private:
+    SlotStore store;
+    VehicleCatalog catalog;
+    OccupancyIndex occupancy;
+    SlotSpatialIndex spatial;
+    SlotAllocator allocator;
+    std::vector<EntryPoint> entryPoints;
+    TariffTable tariffTable;
+    DeadlineQueue deadlines;
+    std::function<void(int, DeadlineKind)> onDeadline;
+    std::vector<int> changed;
+    std::vector<uint8_t> changedMark;
+    EventLog *log = nullptr;
+    HistoryStore *history = nullptr;
+    uint16_t logLevel = 0;
+    uint16_t historyLevel = 0;
+    const Clock *clock = &systemClock();
+    double totalCollected;
+    int64_t epochNs = 0;
+
+    int64_t startNsOf(size_t i) const {
+        return epochNs + (int64_t)store.startSec[i] * 1000000000 + store.startSub[i];
+    }
+
+    void resetState(const std::vector<Rect> &rects) {
+        store.assign(rects);
+        occupancy.reset(store.size());
+        deadlines.reset(store.size());
+        changed.clear();
+        changedMark.assign(store.size(), 0);
+        totalCollected = 0.0;
+        epochNs = steadyNs(std::chrono::steady_clock::now());
+        setEntries({});
+    }
+
+    EntryPoint cornerEntry() const {
+        if (store.rect.empty()) return { 0, 0 };
+        EntryPoint e = { store.rect[0].x, store.rect[0].y };
+        for (const Rect &r: store.rect) { e.x = std::min(e.x, r.x); e.y = std::min(e.y, r.y); }
+        return e;
+    }
+
+    // wallNs is startNs on the wall clock, for the tariff's time of day.
+    void placeVehicle(int i, VehicleHandle h, int64_t startNs, int64_t wallNs) {
+        store.flags[i] = SlotStore::PARKED;
+        store.vehicle[i] = h;
+        store.plan[i] = tariffTable.planFor(catalog[h].type, wallNs);
+        splitNs(startNs - epochNs, store.startSec[i], store.startSub[i]);
+        occupancy.set(i, catalog[h].type);
+        allocator.take(i, store.accepts[i]);
+        deadlines.schedule(i, DEADLINE_OVERSTAY, steadyFromNs(startNs) + std::chrono::seconds(MAX_SECONDS));
+        markChanged(i);
+    }
+
+    void clearVehicle(int i) {
+        occupancy.clear(i, catalog[store.vehicle[i]].type);
+        allocator.release(i, store.accepts[i]);
+        deadlines.cancelAll(i);
+        store.flags[i] = 0;
+        store.vehicle[i] = NO_VEHICLE;
+        markChanged(i);
+    }
+
+    void markChanged(int i) {
+        if (changedMark[i]) return;
+        changedMark[i] = 1;
+        changed.push_back(i);
+    }
+};
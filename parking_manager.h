@@ -0,0 +1,851 @@
+// The parking UI: ParkingManager draws a level of the facility and turns
+// clicks and keys into engine commands. It needs a current GL context but
+// not a window, so main.cpp runs it under GLUT and render_bench.cpp on an
+// offscreen context. The including .cpp provides STB_IMAGE_IMPLEMENTATION.
+//
+// Slots are drawn through a Camera (zoom and pan) under a fixed HUD. Only
+// slots touching the view are drawn, and once they get too small on screen
+// for a sprite and label each is just a coloured cell.
+#pragma once
+
+#include <GL/freeglut.h>
+#include <chrono>  // time measure
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cmath> //
+#include <cstdio>
+#include <memory>
+
+#include "batch_renderer.h"
+#include "camera.h"
+#include "checkpoint.h"
+#include "text_renderer.h"
+#include "lot_engine.h"
+#include "parking_core.h"
+#include "profiler.h"
+#include "sprite_atlas.h"
+
+// ------------------ CONFIG ------------------
+const int WINDOW_W = 1000;
+const int WINDOW_H = 900;
+
+const int SLOT_W = 280;
+const int SLOT_H = 280;
+const int GRID_COLS = 3;
+const int GRID_ROWS = 2;
+const int GAP_X = 50;
+const int GAP_Y = 80;
+
+// UI
+const int HUD_H = 80;                  // fixed band at the top; slots scroll under it
+const int CELL_ONLY_PX = 40;           // slots smaller than this on screen lose sprites, outlines and text
+const float ZOOM_STEP = 1.25f;         // per wheel notch or +/- press
+const int PAN_STEP = 80;               // per arrow key press
+const double MESSAGE_DISPLAY_SEC = 5.0; 
+const int MAX_IDLE_MS = 500;           // longest the frame loop sleeps when nothing is due
+const int POLL_MS = 16;                // while the engine may publish on its own
+const int MIN_FRAME_MS = 16;           // frame cap when the clock runs faster than real time
+const char *const EVENT_LOG = "parking.log";
+const char *const CHECKPOINT_FILE = "parking.checkpoint";
+const int CHECKPOINT_MS = 10000;       // real time between checkpoints, and one on exit
+const char *const PROFILE_TRACE = "parking_trace.json";   // profiling builds only
+const char *const GLYPH_CACHE = "glyphs.cache";
+const double GATE_RATE = 2.0;          // simulated commands per second per gate
+
+const bool FLIP_X_TEXTURE = false;
+const bool FLIP_Y_TEXTURE = false;
+
+// ---------------- Helpers ------------------
+struct TextureInfo {
+    GLuint id = 0;
+    int w = 0;
+    int h = 0;
+    float u0 = 0, v0 = 0, u1 = 1, v1 = 1; // sub-rect when id is an atlas
+};
+
+// Sprite fitted into a box, with texcoords mapped into the texture's sub-rect.
+inline SpriteQuad fitSprite(const TextureInfo &t, int rx, int ry, int rw, int rh, bool flipX, bool flipY) {
+    SpriteQuad q = fitSprite(t.w, t.h, rx, ry, rw, rh, flipX, flipY);
+    q.u0 = t.u0 + q.u0 * (t.u1 - t.u0); q.u1 = t.u0 + q.u1 * (t.u1 - t.u0);
+    q.v0 = t.v0 + q.v0 * (t.v1 - t.v0); q.v1 = t.v0 + q.v1 * (t.v1 - t.v0);
+    return q;
+}
+
+// ----------------- ParkingManager -----------------
+class ParkingManager {
+public:
+    explicit ParkingManager(const FacilityConfig &cfg): selectedSlot(-1), showSelectionMenu(false),
+                      menuX(0), menuY(0), showConfirm(false), confirmSlot(-1),
+                      lastMessage(""), lastMsgTime(), hoverSlot(-1) {
+        facility.build(cfg, WINDOW_W, WINDOW_H);  //MAKE The slots
+        facility.attachHistory(&history);
+        glyphs.addFont(GLUT_BITMAP_HELVETICA_12);
+        glyphs.addFont(GLUT_BITMAP_HELVETICA_18);
+    }
+
+    // Loads the glyph atlas from GLYPH_CACHE, or rasterizes the fonts on the
+    // first frame, once the window is up, and caches them. Must run before
+    // the frame's clear since rasterizing uses the back buffer as scratch.
+    // Without GLUT pass rasterize = false; text is left out if there is no
+    // cache.
+    void ensureTextAtlas(bool rasterize = true) {
+        if (glyphsTried) return;
+        glyphsTried = true;
+        if (glyphs.load(GLYPH_CACHE)) return;
+        if (!rasterize) {
+            glyphs.setBitmapFallback(false);
+            std::cerr << "No " << GLYPH_CACHE << ", drawing without text" << std::endl;
+        } else if (!glyphs.build()) {
+            std::cerr << "Glyph atlas unavailable, using bitmap text" << std::endl;
+        } else if (!glyphs.save(GLYPH_CACHE)) {
+            std::cerr << "Could not write " << GLYPH_CACHE << std::endl;
+        }
+    }
+
+    // Restores the lot from CHECKPOINT_FILE and the event log after it (or
+    // the whole log), then keeps appending to the log and checkpointing.
+    void openLog(const std::string &path) {
+        size_t good = restoreFacility(facility, CHECKPOINT_FILE, path);
+        if (!eventLog.open(path, good)) { std::cerr << "Could not open log: " << eventLog.error() << std::endl; return; }
+        facility.attachLog(&eventLog);
+        engine.setCheckpointHandler([this](FacilityCheckpoint &&c) { checkpoints.submit(std::move(c)); },
+                                    std::chrono::milliseconds(CHECKPOINT_MS));
+    }
+
+    // Call before openLog(); the clock must outlive the manager.
+    void setClock(const Clock &c) { facility.setClock(c); }
+
+    // For scripted drivers that feed the engine directly.
+    LotEngine &lotEngine() { return engine; }
+
+    // Prices on the level on screen, from its compiled tariffs.
+    const std::string &priceText() const { return view->tariffs().summary(); }
+
+    // Hands the facility to the engine thread. From here on the UI only reads
+    // snapshots and submits commands; gateCount simulated gates run alongside.
+    void start(int gateCount, double gateRate) {
+        engine.start();
+        facilityView = engine.snapshot();
+        view = facilityView->levels[currentLevel];
+        fitCamera();
+        if (gateCount > 0) gates.start(engine, gateCount, gateRate);
+        simulatedGates = gateCount;
+    }
+
+    void setTextures(const std::map<std::string, TextureInfo> &t) {
+        textures = t;
+        facility.addVehicle(Vehicle(Vehicle::CAR, textures.at("car").id, textures.at("car").w, textures.at("car").h, "Car"));
+        facility.addVehicle(Vehicle(Vehicle::BIKE, textures.at("bike").id, textures.at("bike").w, textures.at("bike").h, "Bike"));
+        facility.addVehicle(Vehicle(Vehicle::TRUCK, textures.at("truck").id, textures.at("truck").w, textures.at("truck").h, "Truck"));
+        vehicleTex[Vehicle::CAR] = textures.at("car");
+        vehicleTex[Vehicle::BIKE] = textures.at("bike");
+        vehicleTex[Vehicle::TRUCK] = textures.at("truck");
+    }
+
+    void render() {
+        frameNow = facility.clock().now();
+        frameReal = std::chrono::steady_clock::now();
+        dirty = 0;
+        nextTimerRedraw = Clock::TimePoint::max();
+#ifdef PARKING_PROFILE
+        int callsAtStart = RenderStats::drawCalls();
+#endif
+        cullSlots();
+        drawSlots();
+        if (!cellsOnly) {
+            PROFILE_SCOPE("drawSlotText");
+            for (int i: visibleSlots) drawSlotText(i);
+        }
+        drawHUDBar();
+
+        if (showSelectionMenu) renderSelectionMenu();
+        if (showConfirm) renderConfirmDialog();
+        renderTransientMessage();
+
+        if (view->valid(hoverSlot)) {
+            Rect r = slotOnScreen(hoverSlot);
+            drawRectBorder(r.x - 2, r.y - 2, r.w + 4, r.h + 4, 3.0f, 0.0f, 0.6f, 0.0f);
+        }
+        {
+            PROFILE_SCOPE("flush");
+            batch.flush();
+        }
+#ifdef PARKING_PROFILE
+        frameDrawCalls = RenderStats::drawCalls() - callsAtStart;
+#endif
+    }
+
+    // Left clicks act on slots and overlays; right or middle drags pan.
+    void onMouseClick(int mx, int my, int button, int state) {
+        if (button == GLUT_RIGHT_BUTTON || button == GLUT_MIDDLE_BUTTON) {
+            panning = state == GLUT_DOWN;
+            panFromX = mx; panFromY = my;
+            return;
+        }
+        if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN) return;
+
+        Hit hit = hitTest(mx, my);
+        invalidate(DIRTY_ALL);
+
+        if (showConfirm) {
+            if (handleConfirmClick(hit)) return;
+            showConfirm = false; confirmSlot = -1;
+            return;
+        }
+
+        if (showSelectionMenu) {
+            if (handleSelectionClick(hit)) return;
+            showSelectionMenu = false; selectedSlot = -1;
+            return;
+        }
+
+        if (hit.kind == HIT_SLOT) {
+            if (!view->isParked(hit.index)) {
+                Rect s = slotOnScreen(hit.index);
+                selectedSlot = hit.index;
+                int boxW = 3 * 92 + 2 * 12;
+                int bx = s.x + (s.w - boxW) / 2;
+                int by = s.y + s.h + 10;
+                if (by + 140 > WINDOW_H) by = s.y - 140;
+                menuX = std::max(8, bx);
+                menuY = std::max(8, by);
+                showSelectionMenu = true;
+            } else {
+                showConfirm = true;
+                confirmSlot = hit.index;
+            }
+        }
+    }
+
+    // Tab cycles through the levels, 1-9 jump straight to one. C, B and T
+    // park a car, bike or truck in the free slot nearest the level's entry.
+    // + and - zoom, 0 fits the level to the window. In profiling builds P
+    // writes the trace recorded so far.
+    void onKey(unsigned char key) {
+#ifdef PARKING_PROFILE
+        if (key == 'p' || key == 'P') {
+            if (Profiler::instance().writeChromeTrace(PROFILE_TRACE)) showMessage(std::string("Trace written to ") + PROFILE_TRACE);
+            else showMessage(std::string("Could not write ") + PROFILE_TRACE);
+            return;
+        }
+#endif
+        Vehicle::Type autoType = Vehicle::NONE;
+        switch (key) {
+        case 'c': case 'C': autoType = Vehicle::CAR; break;
+        case 'b': case 'B': autoType = Vehicle::BIKE; break;
+        case 't': case 'T': autoType = Vehicle::TRUCK; break;
+        }
+        if (autoType != Vehicle::NONE) {
+            submit({ CMD_PARK, (uint8_t)autoType, UI_GATE, (uint16_t)currentLevel, -1 });
+            return;
+        }
+        if (key == '+' || key == '=') { zoomBy(ZOOM_STEP); return; }
+        if (key == '-') { zoomBy(1.0f / ZOOM_STEP); return; }
+        if (key == '0') { fitCamera(); cameraMoved(); return; }
+        int n = (int)facility.levelCount();
+        int level = currentLevel;
+        if (key == '\t') level = (currentLevel + 1) % n;
+        else if (key >= '1' && key <= '9' && key - '1' < n) level = key - '1';
+        if (level != currentLevel) showLevel(level);
+    }
+
+    // Arrow keys pan.
+    void onSpecialKey(int key) {
+        switch (key) {
+        case GLUT_KEY_LEFT: camera.pan(PAN_STEP, 0); break;
+        case GLUT_KEY_RIGHT: camera.pan(-PAN_STEP, 0); break;
+        case GLUT_KEY_UP: camera.pan(0, PAN_STEP); break;
+        case GLUT_KEY_DOWN: camera.pan(0, -PAN_STEP); break;
+        default: return;
+        }
+        cameraMoved();
+    }
+
+    // direction > 0 zooms in about the pointer.
+    void onWheel(int mx, int my, int direction) {
+        camera.zoomAt((float)mx, (float)my, direction > 0 ? ZOOM_STEP : 1.0f / ZOOM_STEP);
+        cameraMoved();
+    }
+
+    void onMouseMove(int mx, int my) {
+        int slot = slotUnder(mx, my);
+        if (slot != hoverSlot) invalidate(DIRTY_HOVER);
+        hoverSlot = slot;
+    }
+
+    // Motion with a button held.
+    void onMouseDrag(int mx, int my) {
+        if (!panning) return;
+        camera.pan((float)(mx - panFromX), (float)(my - panFromY));
+        panFromX = mx; panFromY = my;
+        cameraMoved();
+    }
+
+    // About the centre of the area under the HUD.
+    void zoomBy(float factor) {
+        Rect a = viewArea();
+        camera.zoomAt(a.x + a.w / 2.0f, a.y + a.h / 2.0f, factor);
+        cameraMoved();
+    }
+
+    void update() {
+        PROFILE_SCOPE("update");
+        std::shared_ptr<const FacilitySnapshot> latest = engine.snapshot();
+        if (latest != facilityView) {
+            facilityView = latest;
+            invalidate(DIRTY_HUD);
+            if (latest->levels[currentLevel] != view) { view = latest->levels[currentLevel]; invalidate(DIRTY_SLOTS); }
+        }
+        LotCompletion done;
+        while (engine.pollCompletion(done)) handleCompletion(done);
+        if (facility.clock().now() >= nextTimerRedraw) invalidate(showConfirm ? DIRTY_SLOTS | DIRTY_DIALOG : DIRTY_SLOTS);
+        if (!lastMessage.empty() && std::chrono::steady_clock::now() >= messageExpiry()) invalidate(DIRTY_MESSAGE);
+    }
+
+    // ---------------- Redraw tracking ----------------
+    // Each part of the scene flags itself when its visible output changes;
+    // the frame loop skips frames while nothing is flagged. A flagged frame
+    // is still drawn in full: GLUT leaves the back buffer undefined after a
+    // swap, so there is nothing to patch a partial repaint onto.
+    enum DirtyFlags {
+        DIRTY_SLOTS = 1, DIRTY_HUD = 2, DIRTY_MENU = 4, DIRTY_DIALOG = 8,
+        DIRTY_MESSAGE = 16, DIRTY_HOVER = 32, DIRTY_ALL = 63
+    };
+
+    void invalidate(unsigned what) { dirty |= what; }
+    bool needsRedraw() const { return dirty != 0; }
+    unsigned dirtyFlags() const { return dirty; }
+
+    // How long the frame loop may sleep before something on screen changes
+    // by itself: a timer label ticking, the message expiring or a deadline.
+    // Labels and deadlines run on the facility clock, the message on real
+    // time; the answer is real milliseconds.
+    int millisUntilNextChange() const {
+        const Clock &clock = facility.clock();
+        Clock::Duration wait = Clock::Duration::max();
+        if (nextTimerRedraw != Clock::TimePoint::max()) wait = clock.realUntil(nextTimerRedraw);
+        DeadlineQueue::TimePoint due;
+        if (view->nextDeadline(due)) {
+            Clock::Duration d = clock.realUntil(due);
+            if (d != Clock::Duration::max()) wait = std::min(wait, d + std::chrono::milliseconds(POLL_MS));   // engine's turn first
+        }
+        if (!lastMessage.empty()) wait = std::min(wait, messageExpiry() - std::chrono::steady_clock::now());
+        // Snapshots arrive without notice while commands are in flight or
+        // gates are running, so poll for them.
+        int cap = (inFlight > 0 || simulatedGates > 0) ? POLL_MS : MAX_IDLE_MS;
+        if (wait == Clock::Duration::max()) return cap;
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait).count() + 1;
+        long long minMs = clock.rate() > 1.0 ? MIN_FRAME_MS : 1;
+        return (int)std::max(minMs, std::min((long long)cap, ms));
+    }
+
+private:
+    HistoryStore history;          // outlives the engine that writes it
+    Facility facility;
+    EventLog eventLog;
+    CheckpointWriter checkpoints{CHECKPOINT_FILE, &eventLog};   // outlives the engine, not the log
+    LotEngine engine{facility};
+    GateSimulator gates;
+    std::shared_ptr<const FacilitySnapshot> facilityView;
+    std::shared_ptr<const LotSnapshot> view;     // the level on screen
+    int currentLevel = 0;
+    uint64_t meshVersion = 0;
+    int inFlight = 0;              // UI commands without a completion yet
+    int simulatedGates = 0;
+    std::map<std::string, TextureInfo> textures;
+    TextureInfo vehicleTex[4];
+    int selectedSlot;
+    bool showSelectionMenu;
+    int menuX, menuY;
+
+    bool showConfirm;
+    int confirmSlot;
+
+    std::string lastMessage;
+    std::chrono::steady_clock::time_point lastMsgTime;
+    int hoverSlot;
+
+    unsigned dirty = DIRTY_ALL;
+    Clock::TimePoint nextTimerRedraw = Clock::TimePoint::max();   // facility clock
+
+    // Sampled once at the top of render(): facility clock time for timers
+    // and bills, real time for UI animation.
+    Clock::TimePoint frameNow;
+    std::chrono::steady_clock::time_point frameReal;
+
+    std::chrono::steady_clock::time_point messageExpiry() const {
+        return lastMsgTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(MESSAGE_DISPLAY_SEC));
+    }
+
+    // Per-frame geometry, plus persistent slot meshes patched from the slots
+    // each new snapshot reports as changed.
+    VertexBatch batch;
+    QuadLayer slotBackgrounds;
+    std::vector<BatchVertex> slotOutlines;
+    std::map<GLuint, QuadPool> vehicleSprites;
+    std::vector<GLuint> slotSpriteTex;
+
+    GlyphAtlas glyphs;
+    bool glyphsTried = false;
+
+    // Timer labels are re-formatted only when the shown second changes.
+    struct SlotLabel {
+        int second = -2;
+        bool overstay = false;
+        std::string text;
+        int width = 0;
+    };
+    std::vector<SlotLabel> slotLabels;
+    std::vector<std::string> slotNames;
+
+    // View onto the level. visibleSlots is rebuilt every frame from the
+    // spatial index; drawIndices is scratch for the partial mesh draws.
+    Camera camera;
+    std::vector<int> visibleSlots;
+    std::vector<GLuint> drawIndices;
+    bool cellsOnly = false;        // slots are below CELL_ONLY_PX on screen
+    bool panning = false;
+    int panFromX = 0, panFromY = 0;
+
+    static Rect viewArea() { return { 0, HUD_H, WINDOW_W, WINDOW_H - HUD_H }; }
+
+    Rect slotOnScreen(int i) const { return camera.toScreen(view->slotRects()[i]); }
+
+    int slotUnder(int mx, int my) const {
+        return my < HUD_H ? -1 : view->slotAt(camera.worldX(mx), camera.worldY(my));
+    }
+
+    // Whole level in view, at 1:1 if it fits.
+    void fitCamera() {
+        const std::vector<Rect> &rects = view->slotRects();
+        if (rects.empty()) { camera = Camera(); return; }
+        int x0 = rects[0].x, y0 = rects[0].y, x1 = x0 + rects[0].w, y1 = y0 + rects[0].h;
+        for (const Rect &r: rects) {
+            x0 = std::min(x0, r.x); y0 = std::min(y0, r.y);
+            x1 = std::max(x1, r.x + r.w); y1 = std::max(y1, r.y + r.h);
+        }
+        camera.fit({ x0, y0, x1 - x0, y1 - y0 }, viewArea());
+    }
+
+    // The selection menu is anchored to its slot, so it closes.
+    void cameraMoved() {
+        showSelectionMenu = false; selectedSlot = -1;
+        hoverSlot = -1;
+        invalidate(DIRTY_ALL);
+    }
+
+    // Slots touching the view, and whether they are big enough on screen for
+    // detail. Changing detail rebuilds the meshes in the other palette.
+    void cullSlots() {
+        PROFILE_SCOPE("cullSlots");
+        visibleSlots.clear();
+        view->forEachSlotIn(camera.toWorld(viewArea()), [this](int i) { visibleSlots.push_back(i); });
+        bool cells = false;
+        if (view->size()) {
+            const Rect &r = view->slotRects()[0];
+            cells = std::min(r.w, r.h) * camera.zoom < CELL_ONLY_PX;
+        }
+        if (cells != cellsOnly) { cellsOnly = cells; slotBackgrounds.resize(0); }
+    }
+
+    void showLevel(int level) {
+        currentLevel = level;
+        view = facilityView->levels[level];
+        slotBackgrounds.resize(0);       // forces buildSlotMeshes
+        slotNames.clear();
+        showSelectionMenu = false; selectedSlot = -1;
+        showConfirm = false; confirmSlot = -1;
+        hoverSlot = -1;
+        fitCamera();
+        invalidate(DIRTY_ALL);
+    }
+
+    void drawHUDBar() {
+        PROFILE_SCOPE("drawHUDBar");
+        drawRect(0,0,WINDOW_W,HUD_H,0.95f,0.96f,0.99f);
+        drawRectBorder(0,0,WINDOW_W,HUD_H,2.5f);
+        drawStringAt("Left Click = Park | Click occupied = Remove (confirmation) | " + priceText(), 12, 28, GLUT_BITMAP_HELVETICA_12);
+        std::ostringstream lv;
+        if (facility.levelCount() > 1)
+            lv << "Level " << facility.levelName(currentLevel) << " (" << currentLevel + 1 << "/" << facility.levelCount()
+               << "): " << view->parkedCount() << " / " << view->size() << "   Tab / 1-9 = switch level   ";
+        lv << "C / B / T = park car / bike / truck nearest the entry";
+        drawStringAt(lv.str(), 12, 54, GLUT_BITMAP_HELVETICA_12);
+
+        std::ostringstream st, tk;
+        st << "Parked: " << facilityView->parkedCount() << " / " << facilityView->capacity;
+        tk << "Collected: " << std::fixed << std::setprecision(0) << facilityView->collected() << " Tk";
+        drawStringAt(st.str(), WINDOW_W - 320, 30, GLUT_BITMAP_HELVETICA_12);
+        drawStringAt(tk.str(), WINDOW_W - 320, 54, GLUT_BITMAP_HELVETICA_12);
+        HistorySummary hour = lastHour();
+        char hs[96];
+        snprintf(hs, sizeof hs, "Last hour: %llu out, avg %.0f s, %.0f%% over, peak %d", (unsigned long long)hour.departures,
+                 hour.averageDwellSec(), 100.0 * hour.overstayRate(), hour.peakOccupied);
+        drawStringAt(hs, WINDOW_W - 320, 74, GLUT_BITMAP_HELVETICA_12);
+        double rate = facility.clock().rate();
+        if (rate != 1.0) {
+            char buf[32];
+            snprintf(buf, sizeof buf, "Clock x%g", rate);
+            drawStringAt(buf, WINDOW_W - 120, 30, GLUT_BITMAP_HELVETICA_12);
+        }
+        if (!camera.isIdentity()) {
+            char buf[32];
+            snprintf(buf, sizeof buf, "Zoom %.0f%%", 100.0 * camera.zoom);
+            drawStringAt(buf, WINDOW_W - 120, 54, GLUT_BITMAP_HELVETICA_12);
+        }
+#ifdef PARKING_PROFILE
+        drawProfileOverlay();
+#endif
+    }
+
+    HistorySummary lastHour() const {
+        int64_t now = facility.clock().wallNs(frameNow);
+        return history.summarize(now - HistoryStore::HOUR_NS, now);
+    }
+
+#ifdef PARKING_PROFILE
+    int frameDrawCalls = 0;
+
+    // Bottom line of the HUD: the previous frame's time, its phases and how
+    // many draw calls it took.
+    void drawProfileOverlay() {
+        Profiler &p = Profiler::instance();
+        char buf[64];
+        snprintf(buf, sizeof buf, "Frame %.2f ms, %d draws | us:", p.lastFrameMs(), frameDrawCalls);
+        std::string line = buf;
+        for (const ProfilePhase &ph: p.lastFramePhases()) {
+            snprintf(buf, sizeof buf, "  %s %.0f", ph.name, ph.ns / 1e3);
+            line += buf;
+        }
+        drawStringAt(line, 12, 74, GLUT_BITMAP_HELVETICA_12);
+    }
+#endif
+
+    // Backgrounds, outlines and sprites in a handful of draw calls, in world
+    // space under the camera. Only slots reported by the lot as changed are
+    // rewritten; when part of the level is off screen only the visible slots
+    // are drawn, by index.
+    void drawSlots() {
+        batch.flush();
+        {
+            PROFILE_SCOPE("patchSlotMeshes");
+            if (slotBackgrounds.size() != view->size()) buildSlotMeshes();
+            else view->forEachChangedSince(meshVersion, [this](int i) { writeSlotBackground(i); writeSlotVehicle(i); });
+            meshVersion = view->version;
+        }
+
+        PROFILE_SCOPE("drawSlots");
+        glPushMatrix();
+        glTranslatef(camera.offX, camera.offY, 0.0f);
+        glScalef(camera.zoom, camera.zoom, 1.0f);
+        if (visibleSlots.size() == view->size()) {
+            slotBackgrounds.draw();
+            if (!cellsOnly) {
+                if (!slotOutlines.empty()) drawVertices(&slotOutlines[0], (int)slotOutlines.size(), GL_LINES, 0, 2.0f);
+                for (auto &p: vehicleSprites) p.second.draw(p.first);
+            }
+        } else {
+            slotBackgrounds.draw(visibleSlots, drawIndices);
+            if (!cellsOnly) {
+                drawIndices.clear();
+                for (int i: visibleSlots) appendIndices(drawIndices, (size_t)i, 8);
+                if (!drawIndices.empty()) drawVertices(&slotOutlines[0], (int)drawIndices.size(), GL_LINES, 0, 2.0f, &drawIndices[0]);
+                for (auto &p: vehicleSprites) p.second.draw(p.first, visibleSlots, drawIndices);
+            }
+        }
+        glPopMatrix();
+    }
+
+    void buildSlotMeshes() {
+        slotBackgrounds.resize(view->size());
+        slotOutlines.assign(view->size() * 8, BatchVertex());
+        for (auto &p: vehicleSprites) p.second.reset(view->size());
+        slotSpriteTex.assign(view->size(), 0);
+        for (size_t i = 0; i < view->size(); ++i) {
+            const Slot &s = view->slot(i);
+            writeQuad(slotBackgrounds.quad(i), (float)s.x, (float)s.y, (float)s.w, (float)s.h, QuadColor());
+            writeOutline(&slotOutlines[i * 8], (float)s.x, (float)s.y, (float)s.w, (float)s.h, QuadColor(0.12f, 0.12f, 0.12f));
+            writeSlotBackground(i);
+            writeSlotVehicle(i);
+        }
+    }
+
+    // Without sprites the cell colour tells the vehicle type.
+    void writeSlotBackground(size_t i) {
+        const Slot &s = view->slot(i);
+        if (cellsOnly) {
+            static const QuadColor typeColor[4] = { QuadColor(0.6f, 0.6f, 0.6f), QuadColor(0.30f, 0.50f, 0.85f),
+                                                    QuadColor(0.95f, 0.65f, 0.20f), QuadColor(0.55f, 0.35f, 0.70f) };
+            if (!s.parked) slotBackgrounds.setColor(i, QuadColor(0.70f, 0.88f, 0.70f));
+            else if (s.overstay) slotBackgrounds.setColor(i, QuadColor(0.90f, 0.25f, 0.25f));
+            else slotBackgrounds.setColor(i, typeColor[s.vehicle.type]);
+        } else if (!s.parked) slotBackgrounds.setColor(i, QuadColor(0.94f, 0.98f, 0.94f));
+        else if (s.overstay) slotBackgrounds.setColor(i, QuadColor(1.0f, 0.78f, 0.78f));
+        else slotBackgrounds.setColor(i, QuadColor(0.97f, 0.97f, 0.97f));
+    }
+
+    void writeSlotVehicle(size_t i) {
+        const Slot &s = view->slot(i);
+        GLuint tex = s.parked && !cellsOnly ? s.vehicle.texId : 0;
+        if (slotSpriteTex[i] && slotSpriteTex[i] != tex) vehicleSprites[slotSpriteTex[i]].erase((int)i);
+        slotSpriteTex[i] = tex;
+        if (!tex) return;
+
+        QuadPool &pool = vehicleSprites[tex];
+        if (pool.capacity() != view->size()) pool.reset(view->size());
+        int pad = std::min(10, std::min(s.w, s.h) / 8);   // small bays are only drawn zoomed in
+        int bw = s.w - 2 * pad;
+        int bh = s.h - 2 * pad;
+        pool.put((int)i, fitSprite(vehicleTex[s.vehicle.type], s.x + pad, s.y + pad, bw, bh, FLIP_X_TEXTURE, FLIP_Y_TEXTURE));
+    }
+
+    // In screen space, so labels stay the font's size at any zoom.
+    void drawSlotText(size_t i) {
+        const Slot &s = view->slot(i);
+        Rect r = slotOnScreen((int)i);
+        if (slotNames.size() != view->size()) {
+            slotNames.resize(view->size());
+            for (size_t k = 0; k < view->size(); ++k) slotNames[k] = "S" + std::to_string(k + 1);
+            slotLabels.assign(view->size(), SlotLabel());
+        }
+        drawStringAt(slotNames[i], r.x + 8, r.y + 14, GLUT_BITMAP_HELVETICA_12);
+
+        void* font = GLUT_BITMAP_HELVETICA_18;
+        SlotLabel &label = slotLabels[i];
+        int second = s.parked ? (int)std::floor(s.elapsedSeconds(frameNow)) : -1;
+        if (second >= 0) nextTimerRedraw = std::min(nextTimerRedraw, s.start_time + std::chrono::seconds(second + 1));
+        if (second != label.second || s.overstay != label.overstay) {
+            label.second = second;
+            label.overstay = s.overstay;
+            char buf[96];
+            if (second < 0) snprintf(buf, sizeof buf, "Empty");
+            else if (!s.overstay) snprintf(buf, sizeof buf, "%d:%02d", second / 60, second % 60);
+            else {
+                int extra = std::max(0, second - s.tariffs->flatSeconds(s.plan));
+                double penalty = s.computeBill(frameNow) - s.flatPrice();
+                snprintf(buf, sizeof buf, "%d:%02d  Over+%ds  Penalty: %.0f Tk", second / 60, second % 60, extra, penalty);
+            }
+            label.text = buf;
+            label.width = getBitmapTextWidth(label.text, font);
+        }
+
+        int tx = r.x + (r.w - label.width)/2;
+        int ty = r.y - 18; 
+        if (ty < 6) ty = r.y + r.h + 8;
+        drawStringAt(label.text, tx, ty, font);
+    }
+
+    // ---------------- Selection Menu ----------------
+    void renderSelectionMenu() {
+        PROFILE_SCOPE("renderSelectionMenu");
+        int boxW = 92, boxH = 120, pad = 12;
+        int totalW = 3*boxW + 2*pad;
+        drawRect(menuX - 8, menuY - 8, totalW + 16, boxH + 16, 0.98f, 0.98f, 1.0f);
+        drawRectBorder(menuX - 8, menuY - 8, totalW + 16, boxH + 16);
+        for (int i = 0; i < 3; ++i) {
+            Rect r = menuItemRect(i);
+            int bx = r.x, by = r.y;
+            drawRect(bx, by, boxW, boxH, 1.0f, 1.0f, 1.0f);
+            drawRectBorder(bx, by, boxW, boxH);
+            TextureInfo t; std::string lab;
+            if (i==0){ t=textures["car"]; lab="Car"; }
+            if (i==1){ t=textures["bike"]; lab="Bike"; }
+            if (i==2){ t=textures["truck"]; lab="Truck"; }
+            if (t.id) drawTexturedRect(t, bx + 8, by + 8, boxW - 16, boxH - 40, FLIP_X_TEXTURE, FLIP_Y_TEXTURE);
+            drawStringAt(lab, bx + 10, by + boxH - 18, GLUT_BITMAP_HELVETICA_12);
+        }
+        drawStringAt("Choose Vehicle", menuX, menuY - 18, GLUT_BITMAP_HELVETICA_12);
+    }
+
+    // ---------- Confirmation Dialog ----------
+    void renderConfirmDialog() {
+        PROFILE_SCOPE("renderConfirmDialog");
+        int dw=520, dh=150;
+        int dx=(WINDOW_W-dw)/2, dy=(WINDOW_H-dh)/2;
+
+        batch.rect(0, 0, WINDOW_W, WINDOW_H, QuadColor(0, 0, 0, 0.35f));
+
+        drawRect(dx, dy, dw, dh, 1.0f,1.0f,1.0f);
+        drawRectBorder(dx, dy, dw, dh);
+        drawStringAt("Do you want to remove the vehicle from this slot?", dx+20, dy+40, GLUT_BITMAP_HELVETICA_18);
+
+        if (view->valid(confirmSlot)) {
+            const Slot &s=view->slot(confirmSlot);
+            if (s.parked) {
+                int elapsed=(int)std::floor(s.elapsedSeconds(frameNow));
+                int minutes = elapsed/60, seconds=elapsed%60;
+                std::ostringstream info;
+                info<<"Elapsed: "<<minutes<<":"<<std::setw(2)<<std::setfill('0')<<seconds;
+                double bill = s.computeBill(frameNow);
+                info<<"   Estimated Bill: "<<std::fixed<<std::setprecision(0)<<bill<<" Tk";
+                drawStringAt(info.str(), dx+20, dy+72, GLUT_BITMAP_HELVETICA_12);
+            }
+        }
+
+        Rect yes = confirmButtonRect(true), no = confirmButtonRect(false);
+
+        drawRect(yes.x, yes.y, yes.w, yes.h, 0.85f,0.95f,0.85f);
+        drawRectBorder(yes.x, yes.y, yes.w, yes.h);
+        drawStringAt("Yes", yes.x + yes.w/2 - 12, yes.y + yes.h/2 + 6, GLUT_BITMAP_HELVETICA_18);
+
+        drawRect(no.x, no.y, no.w, no.h, 0.95f,0.85f,0.85f);
+        drawRectBorder(no.x, no.y, no.w, no.h);
+        drawStringAt("No", no.x + no.w/2 - 8, no.y + no.h/2 + 6, GLUT_BITMAP_HELVETICA_18);
+    }
+
+    // ---------------- Hit Testing ----------------
+    // Overlays are a handful of fixed rects and are tested directly; slots go
+    // through the lot's spatial index so the cost does not grow with the lot.
+    enum HitKind { HIT_NONE, HIT_SLOT, HIT_MENU_ITEM, HIT_CONFIRM_YES, HIT_CONFIRM_NO };
+    struct Hit { HitKind kind; int index; };
+
+    Rect menuItemRect(int i) const {
+        int boxW=92, boxH=120, pad=12;
+        return { menuX + i*(boxW+pad), menuY, boxW, boxH };
+    }
+
+    Rect confirmButtonRect(bool yes) const {
+        int dw=520, dh=150;
+        int dx=(WINDOW_W-dw)/2, dy=(WINDOW_H-dh)/2;
+        int bw=130, bh=48, spacing=40;
+        int bx = yes ? dx + (dw/2) - bw - spacing/2 : dx + (dw/2) + spacing/2;
+        return { bx, dy + dh - bh - 18, bw, bh };
+    }
+
+    Hit hitTest(int mx, int my) const {
+        if (showConfirm) {
+            if (confirmButtonRect(true).contains(mx,my)) return { HIT_CONFIRM_YES, confirmSlot };
+            if (confirmButtonRect(false).contains(mx,my)) return { HIT_CONFIRM_NO, confirmSlot };
+            return { HIT_NONE, -1 };
+        }
+        if (showSelectionMenu) {
+            for (int i = 0; i < 3; ++i)
+                if (menuItemRect(i).contains(mx,my)) return { HIT_MENU_ITEM, i };
+        }
+        int slot = slotUnder(mx, my);
+        if (slot >= 0) return { HIT_SLOT, slot };
+        return { HIT_NONE, -1 };
+    }
+
+    bool handleSelectionClick(const Hit &hit){
+        if(hit.kind!=HIT_MENU_ITEM) return false;
+        Vehicle::Type chosen = Vehicle::NONE;
+        if(hit.index==0) chosen = Vehicle::CAR;
+        if(hit.index==1) chosen = Vehicle::BIKE;
+        if(hit.index==2) chosen = Vehicle::TRUCK;
+        if(chosen!=Vehicle::NONE) submit({ CMD_PARK, (uint8_t)chosen, UI_GATE, (uint16_t)currentLevel, selectedSlot });
+        showSelectionMenu=false; selectedSlot=-1;
+        return true;
+    }
+
+    bool handleConfirmClick(const Hit &hit){
+        if(!view->valid(confirmSlot)){ showConfirm=false; confirmSlot=-1; return true;}
+        if(hit.kind==HIT_CONFIRM_YES){
+            submit({ CMD_REMOVE, 0, UI_GATE, (uint16_t)currentLevel, confirmSlot });
+            showConfirm=false; confirmSlot=-1;
+            return true;
+        } else if(hit.kind==HIT_CONFIRM_NO){ showConfirm=false; confirmSlot=-1; return true;}
+        return false;
+    }
+
+    void submit(const LotCommand &c){
+        if(engine.submit(c)) ++inFlight;
+        else showMessage("Engine busy, try again");
+    }
+
+    // The engine reports back on every UI command; a park can still lose the
+    // slot to a gate that got there first.
+    void handleCompletion(const LotCompletion &done){
+        --inFlight;
+        std::ostringstream m;
+        if(facility.levelCount()>1) m<<facility.levelName(done.level)<<" ";
+        if(done.kind==CMD_REMOVE && done.ok) m<<"Slot "<<(done.slot+1)<<" removed. Bill: "<<std::fixed<<std::setprecision(0)<<done.bill<<" Tk";
+        else if(done.kind==CMD_PARK && done.assigned) m<<(done.ok ? "Parked in slot "+std::to_string(done.slot+1) : std::string("No free slot for that vehicle"));
+        else if(done.kind==CMD_PARK && !done.ok) m<<"Slot "<<(done.slot+1)<<" is no longer free";
+        else return;
+        showMessage(m.str());
+        std::cout<<lastMessage<<std::endl;
+    }
+
+    void showMessage(const std::string &text){
+        lastMessage = text; lastMsgTime=std::chrono::steady_clock::now();
+        invalidate(DIRTY_MESSAGE);
+    }
+
+    void renderTransientMessage(){
+        if(lastMessage.empty()) return;
+        double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(frameReal-lastMsgTime).count();
+        if(elapsed>MESSAGE_DISPLAY_SEC){ lastMessage.clear(); return; }
+        int bw=520,bh=56;
+        int bx=(WINDOW_W-bw)/2;
+        int by=WINDOW_H-bh-18;
+        drawRect(bx,by,bw,bh,0.98f,0.98f,0.88f);
+        drawRectBorder(bx,by,bw,bh);
+        drawStringAt(lastMessage,bx+12,by+36,GLUT_BITMAP_HELVETICA_12);
+    }
+
+    // ---------------- Drawing Helpers ----------------
+    void drawRect(int rx,int ry,int rw,int rh,float r,float g,float b){
+        batch.rect(rx, ry, rw, rh, QuadColor(r,g,b));
+    }
+
+    void drawRectBorder(int rx,int ry,int rw,int rh,float lineWidth=2.0f,float r=0.12f,float g=0.12f,float b=0.12f){
+        batch.border(rx, ry, rw, rh, lineWidth, QuadColor(r,g,b));
+    }
+
+    void drawTexturedRect(const TextureInfo &t,int rx,int ry,int rw,int rh,bool flipX,bool flipY){
+        batch.sprite(t.id, fitSprite(t, rx, ry, rw, rh, flipX, flipY));
+    }
+
+    int getBitmapTextWidth(const std::string &s, void* font){
+        return glyphs.textWidth(s, font);
+    }
+
+    void drawStringAt(const std::string &s,int x,int y,void* font){
+        glyphs.draw(batch, s, x, y, font, QuadColor(0.08f,0.08f,0.08f));
+    }
+
+}; // ParkingManager
+
+// ---------- Load textures ----------
+// All vehicle sprites share one mipmapped atlas texture. The decoded atlas is
+// cached in SPRITE_CACHE and memory-mapped on later launches.
+const char *const SPRITE_CACHE = "sprites.cache";
+
+inline std::map<std::string, TextureInfo> loadVehicleSprites(const std::vector<std::string> &names){
+    std::vector<std::string> files;
+    for(auto &n:names) files.push_back(n+".png");
+    uint64_t stamp=spriteSourceStamp(files);
+
+    SpriteAtlas atlas;
+    if(!atlas.load(SPRITE_CACHE,stamp,files.size())){
+        atlas.build(files);
+        if(!atlas.save(SPRITE_CACHE,stamp)) std::cerr<<"Could not write "<<SPRITE_CACHE<<std::endl;
+    }
+
+    GLuint tex; glGenTextures(1,&tex);
+    glBindTexture(GL_TEXTURE_2D,tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    for(int l=0;l<atlas.levelCount();++l)
+        glTexImage2D(GL_TEXTURE_2D,l,GL_RGBA,atlas.levelWidth(l),atlas.levelHeight(l),0,GL_RGBA,GL_UNSIGNED_BYTE,atlas.level(l));
+    glBindTexture(GL_TEXTURE_2D,0);
+
+    std::map<std::string, TextureInfo> out;
+    float aw=(float)atlas.atlasWidth(), ah=(float)atlas.atlasHeight();
+    for(size_t i=0;i<names.size();++i){
+        const SpriteRect &r=atlas.sprite(i);
+        TextureInfo ti;
+        if(r.w==0){ std::cerr<<"Failed to load "<<files[i]<<std::endl; out[names[i]]=ti; continue; }
+        ti.id=tex; ti.w=r.srcW; ti.h=r.srcH;
+        ti.u0=r.x/aw; ti.v0=r.y/ah; ti.u1=(r.x+r.w)/aw; ti.v1=(r.y+r.h)/ah;
+        out[names[i]]=ti;
+    }
+    atlas.releasePixels();
+    return out;
+}
@@ -0,0 +1,188 @@
+// Scoped phase timers for frames and engine ticks.
+//
+// Built only with -DPARKING_PROFILE; otherwise every macro below expands to
+// nothing and this header pulls in no code. A PROFILE_SCOPE records one
+// begin/end pair into a fixed buffer owned by the calling thread, so timing
+// takes no lock. The UI shows per-phase totals of the last frame, and the
+// whole run can be written out as Chrome trace-event JSON (chrome://tracing,
+// Perfetto).
+//
+//   PROFILE_THREAD("engine");          names the calling thread in the trace
+//   PROFILE_FRAME();                   brackets one frame on the calling thread
+//   PROFILE_SCOPE("drawSlotText");     times the rest of the enclosing block
+//
+// Names must be string literals: phases are told apart by pointer.
+#pragma once
+
+#ifdef PARKING_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ProfileEvent {
+    const char *name;
+    int64_t beginNs, endNs;     // since the profiler started
+};
+
+struct ProfilePhase {
+    const char *name;
+    int64_t ns;
+    uint32_t calls;
+};
+
+class Profiler {
+public:
+    enum { THREAD_EVENTS = 1 << 18 };   // per thread; later events are dropped
+
+    // Never destroyed, so threads still running at exit can keep recording.
+    static Profiler &instance() {
+        static Profiler *p = new Profiler;
+        return *p;
+    }
+
+    int64_t nowNs() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const char *name, int64_t beginNs, int64_t endNs) {
+        ThreadLog &t = threadLog();
+        append(t, name, beginNs, endNs);
+        for (ProfilePhase &p: t.phases)
+            if (p.name == name) { p.ns += endNs - beginNs; ++p.calls; return; }
+        t.phases.push_back({ name, endNs - beginNs, 1 });
+    }
+
+    void nameThread(const char *name) { threadLog().name = name; }
+
+    // ---------------- Frames ----------------
+    // Per thread: phases are summed from one frame's end to the next, so
+    // work done between frames (input, polling) counts towards the next.
+    void beginFrame() { threadLog().frameBegin = nowNs(); }
+
+    void endFrame() {
+        ThreadLog &t = threadLog();
+        int64_t end = nowNs();
+        t.lastFrameNs = end - t.frameBegin;
+        t.lastPhases.clear();
+        for (ProfilePhase &p: t.phases) {
+            if (p.calls) t.lastPhases.push_back(p);
+            p.ns = 0; p.calls = 0;
+        }
+        append(t, "frame", t.frameBegin, end);
+    }
+
+    double lastFrameMs() { return threadLog().lastFrameNs / 1e6; }
+    const std::vector<ProfilePhase> &lastFramePhases() { return threadLog().lastPhases; }
+
+    // ---------------- Export ----------------
+    // Complete ("X") events, one track per thread, times in microseconds.
+    // Safe to call while other threads keep recording; their newest events
+    // may be missed.
+    bool writeChromeTrace(const std::string &path) {
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+        bool first = true;
+        std::lock_guard<std::mutex> lk(logsMu);
+        for (size_t tid = 0; tid < logs.size(); ++tid) {
+            const ThreadLog &t = *logs[tid];
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", tid, t.name ? t.name : "thread");
+            first = false;
+            size_t n = t.count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) {
+                const ProfileEvent &e = t.events[i];
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", e.name, tid,
+                        e.beginNs / 1e3, (e.endNs - e.beginNs) / 1e3);
+            }
+        }
+        fputs("\n]}\n", f);
+        return fclose(f) == 0;
+    }
+
+    // Events lost to full thread buffers.
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lk(logsMu);
+        uint64_t n = 0;
+        for (auto &t: logs) n += t->dropped.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    struct ThreadLog {
+        std::unique_ptr<ProfileEvent[]> events{ new ProfileEvent[THREAD_EVENTS] };
+        std::atomic<size_t> count{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+        const char *name = nullptr;
+        // Frame accounting, touched only by the owning thread.
+        int64_t frameBegin = 0, lastFrameNs = 0;
+        std::vector<ProfilePhase> phases, lastPhases;
+    };
+
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::mutex logsMu;
+    std::vector<std::unique_ptr<ThreadLog>> logs;
+
+    Profiler() {}
+
+    static void append(ThreadLog &t, const char *name, int64_t beginNs, int64_t endNs) {
+        size_t n = t.count.load(std::memory_order_relaxed);
+        if (n < THREAD_EVENTS) {
+            t.events[n] = { name, beginNs, endNs };
+            t.count.store(n + 1, std::memory_order_release);
+        } else {
+            t.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ThreadLog &threadLog() {
+        thread_local ThreadLog *mine = nullptr;
+        if (!mine) {
+            std::lock_guard<std::mutex> lk(logsMu);
+            logs.emplace_back(new ThreadLog);
+            mine = logs.back().get();
+        }
+        return *mine;
+    }
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *n): name(n), begin(Profiler::instance().nowNs()) {}
+    ~ProfileScope() { Profiler::instance().record(name, begin, Profiler::instance().nowNs()); }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *name;
+    int64_t begin;
+};
+
+class ProfileFrame {
+public:
+    ProfileFrame() { Profiler::instance().beginFrame(); }
+    ~ProfileFrame() { Profiler::instance().endFrame(); }
+    ProfileFrame(const ProfileFrame &) = delete;
+    ProfileFrame &operator=(const ProfileFrame &) = delete;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_FRAME() ProfileFrame PROFILE_CONCAT(profileFrame_, __LINE__)
+#define PROFILE_THREAD(name) Profiler::instance().nameThread(name)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+#endif
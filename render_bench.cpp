@@ -0,0 +1,201 @@
+// Offscreen render benchmark. Runs ParkingManager::render for N frames of a
+// scripted lot on an offscreen GL context, so it needs no window or GPU, and
+// reports frame times. Frames can be dumped as PPM and compared against a
+// reference set from an earlier run.
+//
+//   g++ -O2 -std=c++17 render_bench.cpp -o render_bench -lEGL -lGL -lglut -pthread
+//   LIBGL_ALWAYS_SOFTWARE=1 ./render_bench [options]
+//
+//   --slots N        bays on the level (default 10000)
+//   --frames N       frames to time (default 300)
+//   --fill F         fraction parked before the first frame (default 0.6)
+//   --churn K        parks and removes between frames (default 50)
+//   --seed N
+//   --zoom Z         zoom the view by Z about its centre (default: fit)
+//   --dump DIR       write every --every'th frame to DIR/frame_NNNN.ppm
+//   --every K        (default 50)
+//   --compare DIR    compare the same frames against DIR/frame_NNNN.ppm;
+//                    exit status 2 if any pixel differs
+//
+// The facility clock is paused and stepped one second per frame, and every
+// frame waits for the engine to publish the script's commands before it is
+// timed, so a given seed always draws the same frames. Text comes from
+// glyphs.cache, written by any run of the GUI; without it the frames are
+// drawn without text.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "offscreen_gl.h"
+#include "parking_manager.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct Script {
+    LotEngine &engine;
+    std::mt19937 rng;
+    uint64_t submitted = 0;
+
+    void submit(const LotCommand &c) {
+        while (!engine.submit(c)) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++submitted;
+    }
+
+    // Until the snapshot shows every command submitted so far.
+    void settle() {
+        while (engine.settled() < submitted) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    Vehicle::Type randomType() { return (Vehicle::Type)(1 + rng() % 3); }
+
+    void fill(size_t slots, double fraction) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (size_t i = 0; i < slots; ++i)
+            if (unit(rng) < fraction) submit({ CMD_PARK, (uint8_t)randomType(), 1, 0, (int32_t)i });
+        settle();
+    }
+
+    // Parks on free slots and removes from parked ones, as the last
+    // snapshot saw them.
+    void churn(int count) {
+        const LotSnapshot &lot = engine.snapshot()->level(0);
+        for (int k = 0; k < count; ++k) {
+            int32_t i = (int32_t)(rng() % lot.size());
+            if (lot.isParked(i)) submit({ CMD_REMOVE, 0, 1, 0, i });
+            else submit({ CMD_PARK, (uint8_t)randomType(), 1, 0, i });
+        }
+        settle();
+    }
+};
+
+static std::string frameFile(const std::string &dir, int frame) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "/frame_%04d.ppm", frame);
+    return dir + buf;
+}
+
+// Pixels that differ from the reference frame, or -1 if it is missing or a
+// different size.
+static long comparePPM(const std::string &path, int w, int h, const std::vector<uint8_t> &rgb) {
+    int rw, rh;
+    std::vector<uint8_t> ref;
+    if (!readPPM(path, rw, rh, ref) || rw != w || rh != h) return -1;
+    long diff = 0;
+    for (size_t p = 0; p < rgb.size(); p += 3)
+        if (rgb[p] != ref[p] || rgb[p + 1] != ref[p + 1] || rgb[p + 2] != ref[p + 2]) ++diff;
+    return diff;
+}
+
+int main(int argc, char **argv) {
+    int slots = 10000, frames = 300, churn = 50, every = 50;
+    double fill = 0.6, zoom = 1.0;
+    uint32_t seed = 1;
+    std::string dumpDir, compareDir;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char *v = i + 1 < argc ? argv[++i] : "";
+        bool ok = *v != '\0';
+        if (a == "--slots") slots = atoi(v);
+        else if (a == "--frames") frames = atoi(v);
+        else if (a == "--fill") fill = atof(v);
+        else if (a == "--churn") churn = atoi(v);
+        else if (a == "--seed") seed = (uint32_t)strtoul(v, nullptr, 10);
+        else if (a == "--dump") dumpDir = v;
+        else if (a == "--every") every = atoi(v);
+        else if (a == "--compare") compareDir = v;
+        else if (a == "--zoom") zoom = atof(v);
+        else ok = false;
+        if (!ok || slots <= 0 || frames <= 0 || churn < 0 || every <= 0 || fill < 0 || fill > 1 || zoom <= 0) {
+            std::cerr << "Bad option " << a << " (see the top of render_bench.cpp)" << std::endl;
+            return 1;
+        }
+    }
+
+    OffscreenContext gl;
+    if (!gl.create(WINDOW_W, WINDOW_H)) {
+        std::cerr << "Offscreen context: " << gl.error() << std::endl;
+        return 1;
+    }
+    glViewport(0, 0, WINDOW_W, WINDOW_H);
+    glMatrixMode(GL_PROJECTION); glLoadIdentity();
+    glOrtho(0, WINDOW_W, WINDOW_H, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW); glLoadIdentity();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // One level filling the area below the HUD, as square as it goes.
+    int cols = std::max(1, (int)std::ceil(std::sqrt(slots * (double)WINDOW_W / (WINDOW_H - 80))));
+    int rows = (slots + cols - 1) / cols;
+    int pitch = std::max(4, std::min(WINDOW_W / cols, (WINDOW_H - 80) / rows));
+    int slotSize = std::max(2, pitch * 3 / 4);
+    FacilityConfig cfg;
+    cfg.levels.push_back({ "L1", cols, rows, slotSize, slotSize, pitch - slotSize, pitch - slotSize });
+
+    VirtualClock clock(0.0);
+    ParkingManager manager(cfg);
+    manager.setClock(clock);
+    manager.setTextures(loadVehicleSprites({ "car", "bike", "truck" }));
+    manager.start(0, 0.0);
+    if (zoom != 1.0) manager.zoomBy((float)zoom);
+
+    Script script{ manager.lotEngine(), std::mt19937(seed) };
+    script.fill((size_t)cols * rows, fill);
+    int parkedAtStart = manager.lotEngine().snapshot()->parkedCount();
+
+    std::vector<double> frameMs;
+    std::vector<uint8_t> rgb;
+    long draws = 0, mismatched = 0;
+    for (int f = 0; f < frames; ++f) {
+        clock.advance(std::chrono::seconds(1));
+        script.churn(churn);
+
+        int callsBefore = RenderStats::drawCalls();
+        auto t0 = std::chrono::steady_clock::now();
+        manager.update();
+        manager.ensureTextAtlas(false);
+        glClearColor(0.97f, 0.97f, 0.99f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        manager.render();
+        glFinish();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        draws += RenderStats::drawCalls() - callsBefore;
+
+        if (f % every != 0 || (dumpDir.empty() && compareDir.empty())) continue;
+        gl.readPixels(rgb);
+        if (!dumpDir.empty() && !writePPM(frameFile(dumpDir, f), gl.w(), gl.h(), rgb))
+            std::cerr << "Could not write " << frameFile(dumpDir, f) << std::endl;
+        if (!compareDir.empty()) {
+            long diff = comparePPM(frameFile(compareDir, f), gl.w(), gl.h(), rgb);
+            if (diff != 0) {
+                ++mismatched;
+                if (diff < 0) printf("frame %4d  no matching reference\n", f);
+                else printf("frame %4d  %ld pixels differ\n", f, diff);
+            }
+        }
+    }
+
+    double total = 0.0;
+    for (double ms: frameMs) total += ms;
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    printf("renderer    %s\n", gl.renderer().c_str());
+    printf("lot         %d x %d = %d bays, %d px pitch, %d parked before frame 0\n", cols, rows, cols * rows, pitch,
+           parkedAtStart);
+    printf("frames      %d in %.3f s, %.1f frames/s\n", frames, total / 1000.0, frames * 1000.0 / total);
+    printf("frame time  avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", total / frames, sorted[frames / 2],
+           sorted[(size_t)((frames - 1) * 0.99)], sorted.back());
+    printf("draw calls  %.1f per frame\n", (double)draws / frames);
+    if (!compareDir.empty()) {
+        printf("compare     %ld of %d frames differ from %s\n", mismatched, (frames + every - 1) / every, compareDir.c_str());
+        if (mismatched) return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Nearest-free-slot assignment by vehicle type.
+//
+// For every entry point the slots are ranked once by distance from it (slot
+// centres, ties by index). Per entry and vehicle type a hierarchical bitset
+// over those ranks marks the free slots that type may use, so the nearest
+// one is the lowest set rank: one word per level of the hierarchy, three
+// levels up to 262k slots. Parking or freeing a slot flips one bit per entry
+// and accepted type, with the same word count.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "occupancy_index.h"
+#include "spatial_index.h"
+
+struct EntryPoint { int x, y; };
+
+// Bitset with a summary level per 64x: a bit above is set while any bit in
+// the word below it is.
+class RankSet {
+public:
+    void reset(size_t n) {
+        levels.clear();
+        size_t words = n;
+        do {
+            words = std::max<size_t>(1, (words + 63) / 64);
+            levels.emplace_back(words, 0);
+        } while (words > 1);
+    }
+
+    void set(size_t i) {
+        for (auto &l: levels) {
+            uint64_t &w = l[i >> 6];
+            bool had = w != 0;
+            w |= 1ull << (i & 63);
+            if (had) return;
+            i >>= 6;
+        }
+    }
+
+    void clear(size_t i) {
+        for (auto &l: levels) {
+            uint64_t &w = l[i >> 6];
+            w &= ~(1ull << (i & 63));
+            if (w) return;
+            i >>= 6;
+        }
+    }
+
+    // Lowest set position, or -1 when empty.
+    long first() const {
+        if (levels.empty() || !levels.back()[0]) return -1;
+        size_t i = 0;
+        for (size_t k = levels.size(); k-- > 0;) i = i * 64 + lowestBit(levels[k][i]);
+        return (long)i;
+    }
+
+private:
+    std::vector<std::vector<uint64_t>> levels;   // [0] has one bit per position
+};
+
+class SlotAllocator {
+public:
+    static const int TYPES = 4;   // indexed by Vehicle::Type; 0 is unused
+
+    // Ranks the slots for each entry point. Every slot starts out taken;
+    // release() the free ones.
+    void build(const std::vector<Rect> &rects, const std::vector<EntryPoint> &entries) {
+        size_t n = rects.size();
+        ranked.assign(entries.size(), Ranking());
+        std::vector<int64_t> dist(n);
+        for (size_t e = 0; e < entries.size(); ++e) {
+            // Doubled coordinates keep slot centres integral.
+            int64_t ex = 2 * (int64_t)entries[e].x, ey = 2 * (int64_t)entries[e].y;
+            for (size_t i = 0; i < n; ++i) {
+                int64_t dx = 2 * (int64_t)rects[i].x + rects[i].w - ex, dy = 2 * (int64_t)rects[i].y + rects[i].h - ey;
+                dist[i] = dx * dx + dy * dy;
+            }
+            Ranking &r = ranked[e];
+            r.order.resize(n);
+            std::iota(r.order.begin(), r.order.end(), 0);
+            std::sort(r.order.begin(), r.order.end(),
+                      [&](int32_t a, int32_t b) { return dist[a] != dist[b] ? dist[a] < dist[b] : a < b; });
+            r.rankOf.resize(n);
+            for (size_t k = 0; k < n; ++k) r.rankOf[r.order[k]] = (int32_t)k;
+            for (int t = 1; t < TYPES; ++t) r.free[t].reset(n);
+        }
+    }
+
+    size_t entryCount() const { return ranked.size(); }
+
+    // typeMask has bit t set for each Vehicle::Type the slot accepts.
+    void release(int i, uint8_t typeMask) {
+        for (Ranking &r: ranked)
+            for (int t = 1; t < TYPES; ++t)
+                if (typeMask >> t & 1) r.free[t].set((size_t)r.rankOf[i]);
+    }
+
+    void take(int i, uint8_t typeMask) {
+        for (Ranking &r: ranked)
+            for (int t = 1; t < TYPES; ++t)
+                if (typeMask >> t & 1) r.free[t].clear((size_t)r.rankOf[i]);
+    }
+
+    // Free slot closest to the entry point that accepts `type`, or -1.
+    // Entry numbers wrap around the configured ones.
+    int nearest(int type, size_t entry) const {
+        if (ranked.empty() || type <= 0 || type >= TYPES) return -1;
+        const Ranking &r = ranked[entry % ranked.size()];
+        long k = r.free[type].first();
+        return k < 0 ? -1 : r.order[(size_t)k];
+    }
+
+private:
+    struct Ranking {
+        std::vector<int32_t> order;     // slots, nearest first
+        std::vector<int32_t> rankOf;    // slot -> position in order
+        RankSet free[TYPES];            // by rank: free and accepts the type
+    };
+    std::vector<Ranking> ranked;        // one per entry point
+};
@@ -0,0 +1,147 @@
+// Point -> slot and rect -> slots lookup. Regular grids (what initGrid
+// builds) are answered by arithmetic; any other layout goes through a
+// uniform bucket grid.
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+struct Rect {
+    int x, y, w, h;
+    bool contains(int px, int py) const { return px >= x && px <= x + w && py >= y && py <= y + h; }
+    bool intersects(const Rect &o) const { return x <= o.x + o.w && o.x <= x + w && y <= o.y + o.h && o.y <= y + h; }
+};
+
+inline int floorDiv(int a, int b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+// cols x rows cells of cellW x cellH, one every pitchX/pitchY pixels.
+struct GridLayout {
+    int originX = 0, originY = 0;
+    int cellW = 0, cellH = 0;
+    int pitchX = 1, pitchY = 1;
+    int cols = 0, rows = 0;
+
+    Rect cell(int i) const {
+        return { originX + (i % cols) * pitchX, originY + (i / cols) * pitchY, cellW, cellH };
+    }
+
+    int cellAt(int px, int py) const {
+        int lx = px - originX, ly = py - originY;
+        if (lx < 0 || ly < 0) return -1;
+        int c = lx / pitchX, r = ly / pitchY;
+        if (c >= cols || r >= rows) return -1;
+        // Slot bounds are inclusive on the far edge, same as Rect::contains.
+        if (lx - c * pitchX > cellW || ly - r * pitchY > cellH) return -1;
+        return r * cols + c;
+    }
+
+    // fn(i) for every cell touching q, row by row.
+    template <class F>
+    void forEachIn(const Rect &q, F fn) const {
+        int c0 = std::max(0, -floorDiv(originX + cellW - q.x, pitchX));
+        int c1 = std::min(cols - 1, floorDiv(q.x + q.w - originX, pitchX));
+        int r0 = std::max(0, -floorDiv(originY + cellH - q.y, pitchY));
+        int r1 = std::min(rows - 1, floorDiv(q.y + q.h - originY, pitchY));
+        for (int r = r0; r <= r1; ++r)
+            for (int c = c0; c <= c1; ++c) fn(r * cols + c);
+    }
+};
+
+class BucketGrid {
+public:
+    void build(const std::vector<Rect> &rects, int bucketSize) {
+        items = rects;
+        bucket = std::max(1, bucketSize);
+        minX = minY = 0; bx = by = 0;
+        starts.clear(); ids.clear();
+        if (rects.empty()) return;
+        int maxX = rects[0].x + rects[0].w, maxY = rects[0].y + rects[0].h;
+        minX = rects[0].x; minY = rects[0].y;
+        for (auto &r: rects) {
+            minX = std::min(minX, r.x); minY = std::min(minY, r.y);
+            maxX = std::max(maxX, r.x + r.w); maxY = std::max(maxY, r.y + r.h);
+        }
+        bx = (maxX - minX) / bucket + 1;
+        by = (maxY - minY) / bucket + 1;
+
+        // Two passes into one flat array: count per bucket, then fill.
+        starts.assign((size_t)bx * by + 1, 0);
+        forEachBucket([&](size_t b, int) { ++starts[b + 1]; });
+        for (size_t b = 1; b < starts.size(); ++b) starts[b] += starts[b - 1];
+        ids.resize(starts.back());
+        std::vector<int> fill(starts.begin(), starts.end() - 1);
+        forEachBucket([&](size_t b, int i) { ids[fill[b]++] = i; });
+    }
+
+    int query(int px, int py) const {
+        if (starts.empty() || px < minX || py < minY) return -1;
+        int cx = (px - minX) / bucket, cy = (py - minY) / bucket;
+        if (cx >= bx || cy >= by) return -1;
+        size_t b = (size_t)cy * bx + cx;
+        for (int k = starts[b]; k < starts[b + 1]; ++k)
+            if (items[ids[k]].contains(px, py)) return ids[k];
+        return -1;
+    }
+
+    // fn(i) once for every rect touching q, reported from the first bucket
+    // both cover.
+    template <class F>
+    void forEachIn(const Rect &q, F fn) const {
+        if (starts.empty()) return;
+        int x0 = std::max(0, floorDiv(q.x - minX, bucket)), x1 = std::min(bx - 1, floorDiv(q.x + q.w - minX, bucket));
+        int y0 = std::max(0, floorDiv(q.y - minY, bucket)), y1 = std::min(by - 1, floorDiv(q.y + q.h - minY, bucket));
+        for (int cy = y0; cy <= y1; ++cy)
+            for (int cx = x0; cx <= x1; ++cx) {
+                size_t b = (size_t)cy * bx + cx;
+                for (int k = starts[b]; k < starts[b + 1]; ++k) {
+                    const Rect &r = items[ids[k]];
+                    if (!r.intersects(q)) continue;
+                    if (std::max(x0, (r.x - minX) / bucket) == cx && std::max(y0, (r.y - minY) / bucket) == cy) fn(ids[k]);
+                }
+            }
+    }
+
+private:
+    std::vector<Rect> items;
+    std::vector<int> starts, ids;
+    int bucket = 1, minX = 0, minY = 0, bx = 0, by = 0;
+
+    template <class F>
+    void forEachBucket(F fn) const {
+        for (int i = 0; i < (int)items.size(); ++i) {
+            const Rect &r = items[i];
+            int x0 = (r.x - minX) / bucket, x1 = (r.x + r.w - minX) / bucket;
+            int y0 = (r.y - minY) / bucket, y1 = (r.y + r.h - minY) / bucket;
+            for (int y = y0; y <= y1; ++y)
+                for (int x = x0; x <= x1; ++x) fn((size_t)y * bx + x, i);
+        }
+    }
+};
+
+class SlotSpatialIndex {
+public:
+    void buildGrid(const GridLayout &g) { regular = true; grid = g; }
+
+    void buildRects(const std::vector<Rect> &rects) {
+        regular = false;
+        long long avg = 0;
+        for (auto &r: rects) avg += std::max(r.w, r.h);
+        buckets.build(rects, rects.empty() ? 1 : (int)(avg / (long long)rects.size()));
+    }
+
+    bool isRegular() const { return regular; }
+    const GridLayout &layout() const { return grid; }
+
+    int query(int px, int py) const { return regular ? grid.cellAt(px, py) : buckets.query(px, py); }
+
+    template <class F>
+    void forEachIn(const Rect &q, F fn) const {
+        if (regular) grid.forEachIn(q, fn);
+        else buckets.forEachIn(q, fn);
+    }
+
+private:
+    bool regular = true;
+    GridLayout grid;
+    BucketGrid buckets;
+};
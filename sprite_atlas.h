@@ -0,0 +1,242 @@
+// Vehicle sprites packed into one mipmapped RGBA atlas.
+//
+// build() decodes every source image on its own thread, downsizes it to
+// SPRITE_MAX_DIM, shelf-packs the lot and box-filters the mip chain. save()
+// writes that to a binary cache; load() memory-maps the cache and points the
+// level pixels straight into the mapping, so a warm start does no decoding.
+//
+// Needs stb_image.h; the including .cpp provides STB_IMAGE_IMPLEMENTATION.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "stb_image.h"
+
+const int SPRITE_MAX_DIM = 256;
+const int ATLAS_PAD = 4;
+
+// Level-0 atlas pixels; rows run bottom-up like GL texture rows.
+struct SpriteRect {
+    int32_t x, y, w, h;
+    int32_t srcW, srcH;
+};
+
+struct DecodedImage {
+    int w = 0, h = 0;
+    std::vector<uint8_t> rgba;
+};
+
+// Decodes to RGBA, flips to bottom-up rows and box-filters down so the longer
+// side is at most maxDim. Leaves w == 0 if the file could not be read.
+inline DecodedImage decodeSprite(const std::string &file, int maxDim) {
+    DecodedImage img;
+    int w, h, ch;
+    unsigned char *data = stbi_load(file.c_str(), &w, &h, &ch, 4);
+    if (!data) return img;
+
+    int longest = std::max(w, h);
+    int dw = w, dh = h;
+    if (longest > maxDim) {
+        dw = std::max(1, (int)((long long)w * maxDim / longest));
+        dh = std::max(1, (int)((long long)h * maxDim / longest));
+    }
+    img.w = dw; img.h = dh;
+    img.rgba.resize((size_t)dw * dh * 4);
+    for (int y = 0; y < dh; ++y) {
+        int sy0 = (int)((long long)y * h / dh), sy1 = std::max(sy0 + 1, (int)((long long)(y + 1) * h / dh));
+        uint8_t *out = &img.rgba[(size_t)(dh - 1 - y) * dw * 4];
+        for (int x = 0; x < dw; ++x) {
+            int sx0 = (int)((long long)x * w / dw), sx1 = std::max(sx0 + 1, (int)((long long)(x + 1) * w / dw));
+            unsigned sum[4] = { 0, 0, 0, 0 };
+            for (int sy = sy0; sy < sy1; ++sy)
+                for (int sx = sx0; sx < sx1; ++sx)
+                    for (int k = 0; k < 4; ++k) sum[k] += data[((size_t)sy * w + sx) * 4 + k];
+            unsigned n = (unsigned)((sy1 - sy0) * (sx1 - sx0));
+            for (int k = 0; k < 4; ++k) out[x * 4 + k] = (uint8_t)(sum[k] / n);
+        }
+    }
+    stbi_image_free(data);
+    return img;
+}
+
+// Changes whenever a source file is added, removed, resized or touched.
+inline uint64_t spriteSourceStamp(const std::vector<std::string> &files) {
+    uint64_t hsh = 1469598103934665603ull;
+    auto mix = [&hsh](const void *p, size_t n) {
+        const uint8_t *b = (const uint8_t *)p;
+        for (size_t i = 0; i < n; ++i) { hsh ^= b[i]; hsh *= 1099511628211ull; }
+    };
+    for (auto &f: files) {
+        mix(f.data(), f.size());
+        std::error_code ec;
+        int64_t size = (int64_t)std::filesystem::file_size(f, ec);
+        if (ec) size = -1;
+        int64_t mtime = (int64_t)std::filesystem::last_write_time(f, ec).time_since_epoch().count();
+        if (ec) mtime = -1;
+        mix(&size, sizeof size);
+        mix(&mtime, sizeof mtime);
+    }
+    return hsh;
+}
+
+class SpriteAtlas {
+public:
+    bool build(const std::vector<std::string> &files) {
+        mapped.close();
+        std::vector<std::future<DecodedImage>> jobs;
+        for (auto &f: files) jobs.push_back(std::async(std::launch::async, decodeSprite, f, SPRITE_MAX_DIM));
+        std::vector<DecodedImage> images;
+        for (auto &j: jobs) images.push_back(j.get());
+
+        pack(images);
+        owned.assign(levelBytes(), 0);
+        for (size_t i = 0; i < images.size(); ++i) {
+            const SpriteRect &r = rects[i];
+            for (int y = 0; y < r.h; ++y)
+                memcpy(&owned[((size_t)(r.y + y) * width + r.x) * 4], &images[i].rgba[(size_t)y * r.w * 4], (size_t)r.w * 4);
+        }
+        pixels = owned.data();
+        buildMips();
+        return true;
+    }
+
+    bool save(const std::string &path, uint64_t stamp) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            CacheHeader hdr = header(stamp);
+            out.write((const char *)&hdr, sizeof hdr);
+            out.write((const char *)rects.data(), rects.size() * sizeof(SpriteRect));
+            out.write((const char *)pixels, levelBytes());
+            if (!out) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    bool load(const std::string &path, uint64_t stamp, size_t expectedSprites) {
+        if (!mapped.open(path)) return false;
+        CacheHeader hdr;
+        if (mapped.size() < sizeof hdr) { mapped.close(); return false; }
+        memcpy(&hdr, mapped.data(), sizeof hdr);
+        if (memcmp(hdr.magic, "PKAT", 4) != 0 || hdr.version != CACHE_VERSION || hdr.stamp != stamp ||
+            hdr.spriteCount != expectedSprites) { mapped.close(); return false; }
+
+        width = (int)hdr.width; height = (int)hdr.height; levels = (int)hdr.levels;
+        size_t rectBytes = hdr.spriteCount * sizeof(SpriteRect);
+        if (mapped.size() != sizeof hdr + rectBytes + levelBytes()) { mapped.close(); return false; }
+        rects.resize(hdr.spriteCount);
+        memcpy(rects.data(), mapped.data() + sizeof hdr, rectBytes);
+        owned.clear();
+        pixels = mapped.data() + sizeof hdr + rectBytes;
+        return true;
+    }
+
+    int atlasWidth() const { return width; }
+    int atlasHeight() const { return height; }
+    int levelCount() const { return levels; }
+    int levelWidth(int l) const { return std::max(1, width >> l); }
+    int levelHeight(int l) const { return std::max(1, height >> l); }
+
+    const uint8_t *level(int l) const {
+        size_t off = 0;
+        for (int k = 0; k < l; ++k) off += (size_t)levelWidth(k) * levelHeight(k) * 4;
+        return pixels + off;
+    }
+
+    size_t spriteCount() const { return rects.size(); }
+    const SpriteRect &sprite(size_t i) const { return rects[i]; }
+
+    // Drops the pixels once they are on the GPU; rects stay valid.
+    void releasePixels() { owned.clear(); owned.shrink_to_fit(); mapped.close(); pixels = nullptr; }
+
+private:
+    static const uint32_t CACHE_VERSION = 1;
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t stamp;
+        uint32_t spriteCount, width, height, levels;
+    };
+
+    std::vector<SpriteRect> rects;
+    std::vector<uint8_t> owned;
+    MappedFile mapped;
+    const uint8_t *pixels = nullptr;
+    int width = 0, height = 0, levels = 0;
+
+    CacheHeader header(uint64_t stamp) const {
+        CacheHeader h;
+        memcpy(h.magic, "PKAT", 4);
+        h.version = CACHE_VERSION;
+        h.stamp = stamp;
+        h.spriteCount = (uint32_t)rects.size();
+        h.width = (uint32_t)width; h.height = (uint32_t)height; h.levels = (uint32_t)levels;
+        return h;
+    }
+
+    size_t levelBytes() const {
+        size_t n = 0;
+        for (int l = 0; l < levels; ++l) n += (size_t)levelWidth(l) * levelHeight(l) * 4;
+        return n;
+    }
+
+    static int nextPow2(int v) { int p = 1; while (p < v) p <<= 1; return p; }
+
+    // Shelf packing, tallest first, at the narrowest power-of-two width that
+    // keeps the atlas roughly square.
+    void pack(const std::vector<DecodedImage> &images) {
+        std::vector<size_t> order(images.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images[a].h > images[b].h; });
+        int widest = 1;
+        for (auto &img: images) widest = std::max(widest, img.w + 2 * ATLAS_PAD);
+
+        rects.assign(images.size(), SpriteRect());
+        for (width = nextPow2(widest); ; width *= 2) {
+            int x = 0, y = 0, shelf = 0;
+            for (size_t i: order) {
+                const DecodedImage &img = images[i];
+                int cw = img.w + 2 * ATLAS_PAD, chh = img.h + 2 * ATLAS_PAD;
+                if (x + cw > width) { x = 0; y += shelf; shelf = 0; }
+                rects[i] = { x + ATLAS_PAD, y + ATLAS_PAD, img.w, img.h, img.w, img.h };
+                x += cw;
+                shelf = std::max(shelf, chh);
+            }
+            height = nextPow2(std::max(1, y + shelf));
+            if (height <= width) break;
+        }
+        levels = 1;
+        while (levelWidth(levels - 1) > 1 || levelHeight(levels - 1) > 1) ++levels;
+    }
+
+    void buildMips() {
+        for (int l = 1; l < levels; ++l) {
+            const uint8_t *src = level(l - 1);
+            uint8_t *dst = &owned[level(l) - owned.data()];
+            int sw = levelWidth(l - 1), sh = levelHeight(l - 1);
+            int dw = levelWidth(l), dh = levelHeight(l);
+            for (int y = 0; y < dh; ++y) {
+                int y0 = std::min(2 * y, sh - 1), y1 = std::min(2 * y + 1, sh - 1);
+                for (int x = 0; x < dw; ++x) {
+                    int x0 = std::min(2 * x, sw - 1), x1 = std::min(2 * x + 1, sw - 1);
+                    for (int k = 0; k < 4; ++k) {
+                        unsigned s = src[((size_t)y0 * sw + x0) * 4 + k] + src[((size_t)y0 * sw + x1) * 4 + k] +
+                                     src[((size_t)y1 * sw + x0) * 4 + k] + src[((size_t)y1 * sw + x1) * 4 + k];
+                        dst[((size_t)y * dw + x) * 4 + k] = (uint8_t)((s + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+};
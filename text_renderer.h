@@ -0,0 +1,208 @@
+// Bitmap-font text through a glyph atlas. GLUT does not expose its font
+// bitmaps, so build() draws every printable glyph once into the back buffer,
+// reads it back and keeps it as an alpha texture. After that a string is just
+// textured quads in the frame's VertexBatch.
+//
+// save()/load() cache the atlas, so it can also be used where GLUT cannot
+// be initialised (offscreen rendering).
+#pragma once
+
+#include <GL/freeglut.h>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "batch_renderer.h"
+
+class GlyphAtlas {
+public:
+    static const int FIRST = 32, LAST = 126;
+    static const int ATLAS_W = 512, ATLAS_H = 256;
+    static const int DESCENT_PAD = 6;
+
+    GlyphAtlas(): tex(0) {}
+
+    void addFont(void *font) {
+        Face f; f.font = font;
+        faces.push_back(f);
+    }
+
+    bool ready() const { return tex != 0; }
+    GLuint texture() const { return tex; }
+
+    // Without GLUT there is no bitmap text to fall back on; text is then
+    // left out until the atlas is ready.
+    void setBitmapFallback(bool on) { fallback = on; }
+
+    // Needs a current context whose viewport covers ATLAS_W x ATLAS_H.
+    // Leaves the back buffer cleared. Returns false if it could not capture.
+    bool build() {
+        GLint vp[4]; glGetIntegerv(GL_VIEWPORT, vp);
+        if (vp[2] < ATLAS_W || vp[3] < ATLAS_H) return false;
+
+        glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+        glOrtho(0, vp[2], 0, vp[3], -1, 1);
+        glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+        glDisable(GL_TEXTURE_2D);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColor3f(1, 1, 1);
+
+        // Shelf layout, bottom-up so rows match glReadPixels and texture t.
+        int px = 0, py = 0, shelf = 0;
+        for (auto &f: faces) {
+            f.lineH = glutBitmapHeight(f.font);
+            f.cellH = f.lineH + DESCENT_PAD;
+            for (int c = FIRST; c <= LAST; ++c) {
+                Glyph &g = f.glyphs[c - FIRST];
+                g.advance = glutBitmapWidth(f.font, c);
+                g.cellW = g.advance + 2;
+                if (px + g.cellW > ATLAS_W) { px = 0; py += shelf; shelf = 0; }
+                if (py + f.cellH > ATLAS_H) { restoreMatrices(); return false; }
+                glRasterPos2i(px + 1, py + DESCENT_PAD);
+                glutBitmapCharacter(f.font, c);
+                g.u0 = (float)px / ATLAS_W;
+                g.u1 = (float)(px + g.cellW) / ATLAS_W;
+                g.v0 = (float)(py + f.cellH) / ATLAS_H;
+                g.v1 = (float)py / ATLAS_H;
+                px += g.cellW;
+                if (f.cellH > shelf) shelf = f.cellH;
+            }
+        }
+
+        pixels.assign((size_t)ATLAS_W * ATLAS_H, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, ATLAS_W, ATLAS_H, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+        glClear(GL_COLOR_BUFFER_BIT);
+        restoreMatrices();
+        upload();
+        return true;
+    }
+
+    // Metrics of every face, in addFont order, then the alpha pixels. Only
+    // after build().
+    bool save(const std::string &path) const {
+        if (!ready() || pixels.empty()) return false;
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            CacheHeader hdr = { { 'P', 'K', 'G', 'L' }, CACHE_VERSION, (uint32_t)faces.size(), ATLAS_W, ATLAS_H, FIRST, LAST };
+            out.write((const char *)&hdr, sizeof hdr);
+            for (const Face &f: faces) {
+                out.write((const char *)&f.lineH, sizeof f.lineH);
+                out.write((const char *)&f.cellH, sizeof f.cellH);
+                out.write((const char *)f.glyphs, sizeof f.glyphs);
+            }
+            out.write((const char *)pixels.data(), pixels.size());
+            if (!out) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    // Needs a current context and the same fonts added, in the same order,
+    // as when the cache was saved.
+    bool load(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        CacheHeader hdr;
+        size_t faceBytes = sizeof(int) * 2 + sizeof(Face::glyphs);
+        if (data.size() < sizeof hdr) return false;
+        memcpy(&hdr, data.data(), sizeof hdr);
+        if (memcmp(hdr.magic, "PKGL", 4) != 0 || hdr.version != CACHE_VERSION || hdr.faces != faces.size() ||
+            hdr.width != ATLAS_W || hdr.height != ATLAS_H || hdr.first != FIRST || hdr.last != LAST ||
+            data.size() != sizeof hdr + faces.size() * faceBytes + (size_t)ATLAS_W * ATLAS_H)
+            return false;
+        const char *p = data.data() + sizeof hdr;
+        for (Face &f: faces) {
+            memcpy(&f.lineH, p, sizeof f.lineH); p += sizeof f.lineH;
+            memcpy(&f.cellH, p, sizeof f.cellH); p += sizeof f.cellH;
+            memcpy(f.glyphs, p, sizeof f.glyphs); p += sizeof f.glyphs;
+        }
+        pixels.assign((const GLubyte *)p, (const GLubyte *)p + (size_t)ATLAS_W * ATLAS_H);
+        upload();
+        return true;
+    }
+
+    int textWidth(const std::string &s, void *font) const {
+        const Face *f = face(font);
+        int w = 0;
+        if (!f || !ready()) {
+            if (fallback) for (unsigned char c: s) w += glutBitmapWidth(font, c);
+            return w;
+        }
+        for (unsigned char c: s) if (c >= FIRST && c <= LAST) w += f->glyphs[c - FIRST].advance;
+        return w;
+    }
+
+    // (x, y) is the baseline origin, same as glRasterPos for bitmap text.
+    void draw(VertexBatch &batch, const std::string &s, int x, int y, void *font, QuadColor color) const {
+        const Face *f = face(font);
+        if (!f || !ready()) {
+            if (!fallback) return;
+            batch.flush();
+            glDisable(GL_TEXTURE_2D);
+            glColor4ub(color.r, color.g, color.b, color.a);
+            glRasterPos2i(x, y);
+            for (unsigned char c: s) glutBitmapCharacter(font, c);
+            glColor3f(1, 1, 1);
+            return;
+        }
+        int top = y - (f->cellH - DESCENT_PAD);
+        for (unsigned char c: s) {
+            if (c < FIRST || c > LAST) continue;
+            const Glyph &g = f->glyphs[c - FIRST];
+            if (c != ' ') batch.sprite(tex, { x - 1, top, g.cellW, f->cellH, g.u0, g.v0, g.u1, g.v1 }, color);
+            x += g.advance;
+        }
+    }
+
+private:
+    struct Glyph {
+        int advance = 0, cellW = 0;
+        float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+    };
+    struct Face {
+        void *font = nullptr;
+        int lineH = 0, cellH = 0;
+        Glyph glyphs[LAST - FIRST + 1];
+    };
+    std::vector<Face> faces;
+    std::vector<GLubyte> pixels;     // kept for save()
+    GLuint tex;
+    bool fallback = true;
+
+    static const uint32_t CACHE_VERSION = 1;
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version, faces;
+        uint32_t width, height, first, last;
+    };
+
+    void upload() {
+        if (!tex) glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_W, ATLAS_H, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &pixels[0]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    const Face *face(void *font) const {
+        for (auto &f: faces) if (f.font == font) return &f;
+        return nullptr;
+    }
+
+    void restoreMatrices() {
+        glMatrixMode(GL_PROJECTION); glPopMatrix();
+        glMatrixMode(GL_MODELVIEW); glPopMatrix();
+    }
+};
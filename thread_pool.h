@@ -0,0 +1,127 @@
+// Small work-stealing pool for fork/join loops over shards.
+//
+// Every worker has its own deque: it takes work from the back of its own and
+// steals from the front of the others' when it runs dry. parallelFor() deals
+// the iterations out round-robin and the calling thread joins in until they
+// are all done, so a loop never waits on a sleeping worker to start.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // One worker per core besides the caller's.
+    static unsigned defaultWorkers() {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 1 ? hw - 1 : 0;
+    }
+
+    explicit ThreadPool(unsigned workers = defaultWorkers()): queues(workers) {
+        for (unsigned w = 0; w < workers; ++w) queues[w].reset(new Queue);
+        for (unsigned w = 0; w < workers; ++w) threads.emplace_back([this, w] { run(w); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(idleMu);
+            stopping = true;
+        }
+        idle.notify_all();
+        for (auto &t: threads) t.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t workers() const { return threads.size(); }
+
+    // Runs fn(i) for every i in [0, n) and returns once all have finished.
+    // Not reentrant: fn must not call parallelFor on the same pool.
+    template <class F>
+    void parallelFor(size_t n, F fn) {
+        if (threads.empty() || n < 2) {
+            for (size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        std::atomic<size_t> left(n);
+        for (size_t i = 0; i < n; ++i) {
+            Queue &q = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> lk(q.mu);
+            q.tasks.push_back([&fn, &left, i] { fn(i); left.fetch_sub(1, std::memory_order_release); });
+        }
+        {
+            std::lock_guard<std::mutex> lk(idleMu);
+            ++posted;
+        }
+        idle.notify_all();
+
+        Task t;
+        while (left.load(std::memory_order_acquire) != 0) {
+            if (steal(queues.size(), t)) { t(); t = nullptr; }
+            else std::this_thread::yield();
+        }
+    }
+
+private:
+    typedef std::function<void()> Task;
+    struct Queue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex idleMu;
+    std::condition_variable idle;
+    uint64_t posted = 0;
+    bool stopping = false;
+
+    bool popLocal(size_t self, Task &t) {
+        Queue &q = *queues[self];
+        std::lock_guard<std::mutex> lk(q.mu);
+        if (q.tasks.empty()) return false;
+        t = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    // Takes the oldest task of the first other queue that has one.
+    bool steal(size_t self, Task &t) {
+        for (size_t k = 1; k <= queues.size(); ++k) {
+            size_t v = (self + k) % queues.size();
+            if (v == self) continue;
+            Queue &q = *queues[v];
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (q.tasks.empty()) continue;
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        Task t;
+        for (;;) {
+            uint64_t seen;
+            {
+                std::lock_guard<std::mutex> lk(idleMu);
+                if (stopping) return;
+                seen = posted;
+            }
+            while (popLocal(self, t) || steal(self, t)) { t(); t = nullptr; }
+            std::unique_lock<std::mutex> lk(idleMu);
+            idle.wait(lk, [&] { return stopping || posted != seen; });
+        }
+    }
+};
@@ -0,0 +1,158 @@
+// Arrival/departure traces for load testing.
+//
+// A trace is a time-ordered list of arrivals and departures of numbered
+// vehicles. generateTrace() makes one from a TrafficProfile: Poisson arrivals
+// whose rate follows a daily curve with rush-hour peaks, a vehicle mix and a
+// log-normal dwell time. Traces can be saved and loaded as text, or taken from
+// a recorded event log.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "billing.h"
+#include "event_log.h"
+
+enum TraceKind : uint8_t { TRACE_ARRIVE = 1, TRACE_DEPART = 2 };
+
+struct TraceEvent {
+    int64_t atNs;        // since the start of the trace
+    uint32_t vehicle;    // pairs a departure with its arrival
+    uint8_t kind;
+    uint8_t type;        // Vehicle::Type, arrivals only
+    uint16_t level;      // level the vehicle heads for first
+};
+
+struct RushHour {
+    double hour;         // centre, hours since midnight
+    double width;        // standard deviation, hours
+    double factor;       // peak rate as a multiple of the base rate
+};
+
+struct TrafficProfile {
+    double hours = 24.0;                 // trace length
+    double startHour = 0.0;              // time of day the trace starts at
+    double arrivalsPerSec = 10.0;        // base rate, outside the peaks
+    std::vector<RushHour> peaks = { { 8.5, 1.0, 4.0 }, { 17.5, 1.25, 4.0 } };
+    double mix[3] = { 0.6, 0.3, 0.1 };   // car, bike, truck
+    double dwellMedianSec = 2.0 * MAX_SECONDS;
+    double dwellSigma = 0.8;             // of log(dwell)
+    int levels = 1;
+    uint32_t seed = 1;
+
+    double rateAt(double hourOfDay) const {
+        double r = 1.0;
+        for (const RushHour &p: peaks) {
+            double d = std::fmod(hourOfDay - p.hour + 36.0, 24.0) - 12.0;   // wraps round midnight
+            r += (p.factor - 1.0) * std::exp(-0.5 * d * d / (p.width * p.width));
+        }
+        return arrivalsPerSec * r;
+    }
+
+    double peakRate() const {
+        double r = arrivalsPerSec;
+        for (const RushHour &p: peaks) r += arrivalsPerSec * std::max(0.0, p.factor - 1.0);
+        return r;
+    }
+};
+
+// Non-homogeneous Poisson arrivals by thinning a process at the peak rate.
+// Departures whose time falls past the end of the trace are left out, so the
+// lot ends the trace partly full.
+inline std::vector<TraceEvent> generateTrace(const TrafficProfile &p) {
+    std::mt19937_64 rng(p.seed);
+    std::exponential_distribution<double> gap(p.peakRate());
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::lognormal_distribution<double> dwell(std::log(p.dwellMedianSec), p.dwellSigma);
+    std::discrete_distribution<int> type({ p.mix[0], p.mix[1], p.mix[2] });
+    std::uniform_int_distribution<int> level(0, std::max(1, p.levels) - 1);
+
+    std::vector<TraceEvent> events;
+    double end = p.hours * 3600.0;
+    double expected = 0.0;
+    for (double h = 0.0; h < p.hours; h += 0.1) expected += p.rateAt(p.startHour + h) * 360.0;
+    events.reserve((size_t)(2.1 * expected));
+    uint32_t next = 0;
+    for (double t = gap(rng); t < end; t += gap(rng)) {
+        if (unit(rng) * p.peakRate() > p.rateAt(p.startHour + t / 3600.0)) continue;
+        uint32_t id = next++;
+        uint16_t lv = (uint16_t)level(rng);
+        events.push_back({ (int64_t)(t * 1e9), id, TRACE_ARRIVE, (uint8_t)(1 + type(rng)), lv });
+        double leave = t + dwell(rng);
+        if (leave < end) events.push_back({ (int64_t)(leave * 1e9), id, TRACE_DEPART, 0, lv });
+    }
+    std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.atNs < b.atNs; });
+    return events;
+}
+
+// One event per line: seconds, A or D, vehicle type, vehicle id, level.
+inline bool saveTrace(const std::string &path, const std::vector<TraceEvent> &events) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "# seconds kind type vehicle level\n";
+    char buf[96];
+    for (const TraceEvent &e: events) {
+        snprintf(buf, sizeof buf, "%.6f %c %u %u %u\n", e.atNs / 1e9, e.kind == TRACE_ARRIVE ? 'A' : 'D',
+                 (unsigned)e.type, (unsigned)e.vehicle, (unsigned)e.level);
+        out << buf;
+    }
+    return (bool)out;
+}
+
+inline bool loadTrace(const std::string &path, std::vector<TraceEvent> &events, int &badLine) {
+    std::ifstream in(path);
+    badLine = 0;
+    if (!in) return false;
+    std::vector<TraceEvent> out;
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        double sec; char kind; unsigned type, vehicle, level;
+        if (!(ls >> sec >> kind >> type >> vehicle >> level) || (kind != 'A' && kind != 'D') || level > 0xFFFF ||
+            (kind == 'A' && (type < 1 || type > 3))) {   // car, bike or truck
+            badLine = n;
+            return false;
+        }
+        out.push_back({ (int64_t)std::llround(sec * 1e9), vehicle, (uint8_t)(kind == 'A' ? TRACE_ARRIVE : TRACE_DEPART),
+                        (uint8_t)type, (uint16_t)level });
+    }
+    std::stable_sort(out.begin(), out.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.atNs < b.atNs; });
+    events.swap(out);
+    return true;
+}
+
+// Turns a recorded event log into a trace: each park is an arrival, the next
+// remove from the same slot its departure. Times are relative to the first
+// record. Slot numbers are not kept; the replay assigns its own.
+inline std::vector<TraceEvent> traceFromLog(const std::string &path) {
+    std::vector<TraceEvent> events;
+    std::map<std::pair<uint16_t, int32_t>, uint32_t> parked;
+    int64_t first = 0;
+    bool started = false;
+    uint32_t next = 0;
+    EventLog::replay(path, [&](const LogRecord &r) {
+        if (!started) { first = r.wallNs; started = true; }
+        auto key = std::make_pair(r.level, r.slot);
+        int64_t at = std::max<int64_t>(0, r.wallNs - first);
+        if (r.kind == LOG_PARK) {
+            parked[key] = next;
+            events.push_back({ at, next++, TRACE_ARRIVE, r.vehicleType, r.level });
+        } else if (r.kind == LOG_REMOVE) {
+            auto it = parked.find(key);
+            if (it == parked.end()) return;
+            events.push_back({ at, it->second, TRACE_DEPART, 0, r.level });
+            parked.erase(it);
+        }
+    });
+    std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.atNs < b.atNs; });
+    return events;
+}